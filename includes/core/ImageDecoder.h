@@ -0,0 +1,111 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Decoded image in CPU memory (8 bits per channel, rows bottom-up for GL)
+struct ImageData
+{
+    struct Free { void operator()(unsigned char* pixels) const; };
+    std::unique_ptr<unsigned char, Free> pixels;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+
+    explicit operator bool() const { return pixels != nullptr; }
+};
+
+// GPU block formats the texture pipeline encodes to (see TextureCompressor)
+enum class BlockFormat : uint32_t
+{
+    BC1,    // RGB, 8 bytes per 4x4 block
+    BC3,    // RGBA, 16 bytes per block
+    BC4,    // R, 8 bytes per block
+    BC5     // RG, 16 bytes per block
+};
+
+// Block-compressed image with its whole mip chain (rows bottom-up, like ImageData)
+struct CompressedImage
+{
+    struct Level
+    {
+        int width = 0;
+        int height = 0;
+        size_t offset = 0;  // into data
+        size_t size = 0;
+    };
+
+    BlockFormat format = BlockFormat::BC1;
+    int channels = 0;                   // of the source image
+    std::vector<Level> levels;          // full size first
+    std::vector<unsigned char> data;    // the blocks (may hold other bytes around them)
+
+    const unsigned char* LevelData(size_t level) const { return data.data() + levels[level].offset; }
+    explicit operator bool() const { return !levels.empty(); }
+};
+
+// Small thread pool that decodes image files (stb_image), for texture loads.
+// - Decode() queues a file and returns at once; any thread may call it
+// - requests for a file whose decode is still referenced share that decode
+// - the GL upload is left to the caller (see ResourceManager), on the GL thread
+// - without Init(), Decode() decodes on the calling thread before returning
+// - when the GL supports block compression, jobs produce a CompressedImage instead:
+//   loaded from the file's TextureCache entry, or cooked from the file and saved
+//   there the first time
+class ImageDecoder
+{
+public:
+    class Job
+    {
+    public:
+        const std::string& Path() const { return path; }
+        // Once Ready(), either Image() holds the pixels or Compressed() the blocks
+        // (both empty if the file could not be decoded)
+        bool Ready() const { return state.load(std::memory_order_acquire) == DONE; }
+        const ImageData& Image() const { return image; }
+        const CompressedImage& Compressed() const { return compressed; }
+
+    private:
+        friend class ImageDecoder;
+        enum : int { QUEUED, RUNNING, DONE };
+
+        std::string path;
+        ImageData image;
+        CompressedImage compressed;
+        std::atomic<int> state{ QUEUED };
+    };
+
+    // Decoding and cooking share the CPU with the JobSystem workers, so the pool
+    // stays small: threads = 0 starts DEFAULT_THREADS (fewer on small machines)
+    static constexpr unsigned DEFAULT_THREADS = 2;
+    static void Init(unsigned threads = 0);
+    static void Shutdown();
+
+    static std::shared_ptr<const Job> Decode(const std::string& path);
+    // Blocks until the job is done; a job no worker has started yet is decoded
+    // on the calling thread instead
+    static void Wait(const Job& job);
+
+    // Decodes on the calling thread, outside the pool
+    static ImageData DecodeNow(const std::string& path);
+
+private:
+    static void workerMain();
+    static void run(Job& job);
+
+    static std::vector<std::thread> workers;
+    static std::mutex mutex;
+    static std::condition_variable wake;
+    static std::condition_variable finished;
+    static std::deque<std::shared_ptr<Job>> queue;
+    // decodes by path, while anyone still holds them (expired ones are dropped by Decode)
+    static std::unordered_map<std::string, std::weak_ptr<Job>> jobs;
+    static bool stopping;
+};
@@ -22,6 +22,9 @@ public:
 	// scroll: callback gets yoffset
 	void BindScroll(std::function<void(double)> callback);
 
+	// mouse button event (PRESS/RELEASE); only while the mouse is captured
+	void BindMouseButton(int button, int action, std::function<void()> callback);
+
 	// Called by Window static callbacks
 	void HandleKey(int key, int action, int mods);
 	void HandleMouseMove(double xpos, double ypos);
@@ -54,6 +57,9 @@ private:
 
 	// Scroll callbacks
 	std::vector<std::function<void(double)>> scrollCallbacks;
+
+	// Mouse button bindings: button -> list of (action, callback)
+	std::unordered_map<int, std::vector<KeyEventBind>> mouseButtonBindings;
 	
 
 	double lastX;
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed thread pool for data-parallel loops.
+// - ParallelFor splits [0, count) into chunks that the workers and the calling
+//   thread take in turn; it returns once every chunk is done
+// - one loop runs at a time, issued by the thread that called Init(); calls from any
+//   other thread (e.g. a background loader, or a loop body) run serially on that thread
+// - without Init(), or for small loops, everything runs on the calling thread
+class JobSystem
+{
+public:
+    // threads = 0: one worker per hardware thread, minus the main thread
+    static void Init(unsigned threads = 0);
+    static void Shutdown();
+
+    static unsigned WorkerCount() { return static_cast<unsigned>(workers.size()); }
+
+    // fn(begin, end) is called for consecutive chunks of at most `grain` items
+    static void ParallelFor(uint32_t count, uint32_t grain,
+        const std::function<void(uint32_t, uint32_t)>& fn);
+
+private:
+    struct Loop
+    {
+        const std::function<void(uint32_t, uint32_t)>* fn = nullptr;
+        uint32_t count = 0;
+        uint32_t grain = 1;
+        uint32_t chunks = 0;
+        std::atomic<uint32_t> next{ 0 };
+        std::atomic<uint32_t> done{ 0 };
+    };
+
+    static void workerMain();
+    static void runChunks(Loop& loop);
+
+    static std::vector<std::thread> workers;
+    static std::mutex mutex;
+    static std::condition_variable wake;
+    static std::condition_variable finished;
+    static Loop* current;
+    static uint64_t generation;
+    static unsigned active;     // workers currently inside a loop
+    static bool stopping;
+    static std::thread::id owner;
+};
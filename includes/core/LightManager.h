@@ -1,7 +1,7 @@
 #pragma once
+#include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <vector>
-#include "helpers/shaderClass.h"
 
 struct PointLight {
     glm::vec3 position;
@@ -29,8 +29,59 @@ struct SpotLight {
     float quadratic;
 };
 
+// ----------------------------------------------------------------------------
+// std140 mirrors of the "Lights" uniform block in modularFragmentShader.fs.
+// Scalars are tucked into the padding slot after each vec3.
+struct GPUDirLight {
+    glm::vec3 direction; float pad0 = 0.0f;
+    glm::vec3 ambient;   float pad1 = 0.0f;
+    glm::vec3 diffuse;   float pad2 = 0.0f;
+    glm::vec3 specular;  float pad3 = 0.0f;
+};
+
+struct GPUPointLight {
+    glm::vec3 position;  float constant;
+    glm::vec3 ambient;   float linear;
+    glm::vec3 diffuse;   float quadratic;
+    glm::vec3 specular;  float pad = 0.0f;
+};
+
+struct GPUSpotLight {
+    glm::vec3 position;  float constant;
+    glm::vec3 direction; float linear;
+    glm::vec3 ambient;   float quadratic;
+    glm::vec3 diffuse;   float innerCutOff;
+    glm::vec3 specular;  float outerCutOff;
+};
+
+static constexpr int MAX_POINT_LIGHTS = 8; // must match shader (#define MAX_POINT_LIGHTS 8)
+static constexpr int MAX_SPOT_LIGHTS = 4;  // must match shader (#define MAX_SPOT_LIGHTS 4)
+
+struct LightBlock {
+    GPUDirLight dirLight;
+    GPUPointLight pointLights[MAX_POINT_LIGHTS];
+    GPUSpotLight spotLights[MAX_SPOT_LIGHTS];
+    int numPointLights = 0;
+    int numSpotLights = 0;
+    int pad[2] = { 0, 0 };
+};
+
+static_assert(sizeof(GPUDirLight) == 64, "GPUDirLight must match std140 layout");
+static_assert(sizeof(GPUPointLight) == 64, "GPUPointLight must match std140 layout");
+static_assert(sizeof(GPUSpotLight) == 80, "GPUSpotLight must match std140 layout");
+
+// Owns the scene lights and the uniform buffer every lit shader reads them from.
+// Lights can be edited freely (points/spots are public); Upload() packs them and
+// only re-sends the lights whose packed data actually changed.
 class LightManager {
 public:
+    LightManager() = default;
+    ~LightManager();
+
+    // non-copyable (owns the GL buffer)
+    LightManager(const LightManager&) = delete;
+    LightManager& operator=(const LightManager&) = delete;
+
     void SetDirectional(const glm::vec3& dir,
         const glm::vec3& ambient,
         const glm::vec3& diffuse,
@@ -41,15 +92,25 @@ public:
     void ClearPointLights();
     void ClearSpotLights();
 
-    // Apply stored lights to the currently used shader
-    void ApplyToShader(Shader& shader);
+    // Lights the shaders actually see (clamped to the shader maximums)
+    int PointLightCount() const;
+    int SpotLightCount() const;
+
+    // Send changed lights to the GPU buffer and bind it to UniformBinding::Lights
+    void Upload();
 
     std::vector<PointLight> points;
     std::vector<SpotLight> spots;
 
 private:
+    void pack(LightBlock& block) const;
+
     glm::vec3 dir = glm::vec3(0.0f);
     glm::vec3 dirAmbient = glm::vec3(0.0f);
     glm::vec3 dirDiffuse = glm::vec3(0.0f);
     glm::vec3 dirSpec = glm::vec3(0.0f);
-};
\ No newline at end of file
+
+    GLuint ubo = 0;
+    LightBlock uploaded{};  // what the GPU currently holds
+    LightBlock staging{};   // this frame's packed lights
+};
@@ -1,29 +1,59 @@
 #pragma once
 #include <string>
 #include <map>
+#include <vector>
 #include <memory>
 #include <glad/glad.h>
 #include "helpers/shaderClass.h"
 #include "core/rendering/Mesh.h"
+#include "core/ImageDecoder.h"
 
 class ResourceManager
 {
 public:
 
     // Shaders
+    // defines: feature switches compiled into the program ("DIFFUSE_MAP", "NUM_POINT=4", ...)
     static std::shared_ptr<Shader> LoadShader(const std::string& name,
         const std::string& vsPath,
-        const std::string& fsPath);
+        const std::string& fsPath,
+        const std::vector<std::string>& defines = {});
     static std::shared_ptr<Shader> GetShader(const std::string& name);
 
+    // Same sources as base, compiled with another set of defines. One program per
+    // distinct set is built and cached (the order of the defines does not matter).
+    static std::shared_ptr<Shader> LoadShaderVariant(const Shader& base,
+        const std::vector<std::string>& defines);
+
+    // Instanced twin of a program: same fragment shader and defines (plus extraDefines),
+    // vertex shader "<name>Instanced.vs" next to the original.
+    // Returns nullptr when no such vertex shader exists.
+    static std::shared_ptr<Shader> LoadInstancedVariant(const Shader& base,
+        const std::vector<std::string>& extraDefines = {});
+
     // Textures
+    // Files are decoded by the ImageDecoder pool (block-compressed with their mips when
+    // the GL supports it, see TextureCache); the pixels then stream in through
+    // TextureUploader over the next frames (Texture::ready tells when they are in)
     static std::shared_ptr<Texture> LoadTexture(const std::string& path, TextureType type);
+    // Several at once: every decode is queued first, and each texture is created as
+    // soon as its decode finishes. Results are in request order (null on failure)
+    static std::vector<std::shared_ptr<Texture>> LoadTextures(
+        const std::vector<std::pair<std::string, TextureType>>& requests);
     static std::shared_ptr<Texture> GetTexture(const std::string& path);
 
+    // Creates the texture for an image decoded elsewhere (see ImageDecoder), queues its
+    // pixels with TextureUploader and caches it under path (an already cached path returns
+    // the cached texture and ignores source). Null if the decode failed. GL thread only
+    static std::shared_ptr<Texture> CreateTexture(const std::string& path, TextureType type,
+        const std::shared_ptr<const ImageDecoder::Job>& source);
+
     // Cleanup GPU resources
     static void Clear();
 
 private:
+    static std::string variantKey(const std::string& vsPath, const std::string& fsPath,
+        std::vector<std::string> defines);
 
     static std::map<std::string, std::shared_ptr<Shader>> shaders;
     static std::map<std::string, std::shared_ptr<Texture>> textures;
@@ -0,0 +1,47 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "core/rendering/geometry/BVH.h"
+
+struct Entity;
+class Mesh;
+class Model;
+
+// ----------------------------------------------------------------------------
+// BVH over the world-space boxes of a scene's entities. Rays that reach an
+// entity continue into its meshes' triangle BVHs (in object space), so a pick
+// returns the entity, the mesh and the triangle.
+// - transforms are captured by Build(): rebuild after entities move
+// - meshes built without a BVH are hit on their bounding box
+class SceneBVH
+{
+public:
+    void Build(const std::vector<Entity>& entities);
+    void Clear();
+
+    // Closest hit nearer than hit.t (world space; t is along ray.direction)
+    bool Raycast(const Ray& ray, RayHit& hit) const;
+    // Any hit before ray.tMax (occlusion / line of sight)
+    bool RaycastAny(const Ray& ray) const;
+    // Entities whose world boxes overlap the box (collision broad phase)
+    void QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& entities) const;
+
+    size_t InstanceCount() const { return instances.size(); }
+
+private:
+    struct Instance
+    {
+        glm::mat4 inverseModel;
+        const Mesh* mesh = nullptr;     // Mesh entities
+        const Model* model = nullptr;   // Model entities
+        uint32_t entity = 0;
+        glm::vec3 min, max;             // world box
+    };
+
+    // tests one instance; `any` stops at the first triangle before hit.t
+    bool intersect(const Instance& instance, const Ray& ray, RayHit& hit, bool any) const;
+
+    std::vector<BVH::Node> nodes;
+    std::vector<Instance> instances;    // leaf order
+};
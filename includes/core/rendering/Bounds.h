@@ -0,0 +1,71 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// ----------------------------------------------------------------------------
+// Local-space bounding volumes of a mesh or model: an AABB plus a bounding sphere.
+// Default-constructed bounds are invalid (empty) and are never culled.
+struct Bounds
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f); // sphere center (= box center)
+    float radius = 0.0f;
+    bool valid = false;
+
+    // Positions read from interleaved float data, `stride` floats apart
+    static Bounds FromPositions(const float* data, std::size_t count, std::size_t stride)
+    {
+        Bounds b;
+        if (!data || count == 0) return b;
+
+        b.min = b.max = glm::vec3(data[0], data[1], data[2]);
+        for (std::size_t i = 1; i < count; ++i)
+        {
+            glm::vec3 p(data[i * stride], data[i * stride + 1], data[i * stride + 2]);
+            b.min = glm::min(b.min, p);
+            b.max = glm::max(b.max, p);
+        }
+
+        // sphere around the box center, but only as large as the farthest vertex
+        b.center = (b.min + b.max) * 0.5f;
+        float r2 = 0.0f;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            glm::vec3 d = glm::vec3(data[i * stride], data[i * stride + 1], data[i * stride + 2]) - b.center;
+            r2 = glm::max(r2, glm::dot(d, d));
+        }
+        b.radius = glm::sqrt(r2);
+        b.valid = true;
+        return b;
+    }
+
+    // Grow to enclose other bounds
+    void Merge(const Bounds& other)
+    {
+        if (!other.valid) return;
+        if (!valid) { *this = other; return; }
+
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+
+        glm::vec3 c = (min + max) * 0.5f;
+        radius = glm::max(glm::length(center - c) + radius, glm::length(other.center - c) + other.radius);
+        center = c;
+    }
+
+    // World-space AABB of the box under an affine transform
+    void Transform(const glm::mat4& m, glm::vec3& outMin, glm::vec3& outMax) const
+    {
+        glm::vec3 c = (min + max) * 0.5f;
+        glm::vec3 e = (max - min) * 0.5f;
+
+        glm::vec3 worldCenter = glm::vec3(m * glm::vec4(c, 1.0f));
+        glm::vec3 worldExtent = glm::abs(glm::vec3(m[0])) * e.x
+            + glm::abs(glm::vec3(m[1])) * e.y
+            + glm::abs(glm::vec3(m[2])) * e.z;
+
+        outMin = worldCenter - worldExtent;
+        outMax = worldCenter + worldExtent;
+    }
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// World-space boxes kept as one array per coordinate so the cull kernel can load 4 at once
+struct BoxList
+{
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+    void Push(const glm::vec3& min, const glm::vec3& max);
+    void Clear();
+    std::size_t Size() const { return minX.size(); }
+};
+
+// Six view-frustum planes (inside where dot(plane.xyz, p) + plane.w >= 0)
+class Frustum
+{
+public:
+    // Gribb/Hartmann extraction from a combined projection * view matrix
+    void Extract(const glm::mat4& viewProjection);
+
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+    bool IntersectsBox(const glm::vec3& min, const glm::vec3& max) const;
+
+    // visible[i] = 1 if box i is at least partly inside. SSE2 tests 4 boxes per step,
+    // the remainder (or everything, without SSE2) goes through IntersectsBox.
+    void CullBoxes(const BoxList& boxes, std::vector<uint8_t>& visible) const;
+
+private:
+    glm::vec4 planes[6] = {};
+};
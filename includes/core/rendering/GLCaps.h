@@ -0,0 +1,93 @@
+#pragma once
+#include <glad/glad.h>
+
+// glad is generated for GL 3.3 core; the few newer entry points and enums the
+// renderer can use are declared and loaded here. Paths that need them check the
+// matching capability and keep a GL 3.3 fallback.
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+typedef void (APIENTRYP PFN_glMultiDrawElementsIndirect)(GLenum mode, GLenum type,
+    const void* indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFN_glBufferStorage)(GLenum target, GLsizeiptr size, const void* data,
+    GLbitfield flags);
+typedef void (APIENTRYP PFN_glGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei* length,
+    GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFN_glProgramBinary)(GLuint program, GLenum binaryFormat, const void* binary,
+    GLsizei length);
+typedef void (APIENTRYP PFN_glProgramParameteri)(GLuint program, GLenum pname, GLint value);
+
+// Layout of one GL_DRAW_INDIRECT_BUFFER entry for glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+class GLCaps
+{
+public:
+    // Query the context version and load post-3.3 functions (context must be current)
+    static void Load(GLADloadproc loader);
+
+    static int Major() { return major; }
+    static int Minor() { return minor; }
+    static bool AtLeast(int maj, int min) { return major > maj || (major == maj && minor >= min); }
+
+    // GL 4.3: glMultiDrawElementsIndirect + shader storage buffers (+ base instance from 4.2)
+    static bool MultiDrawIndirect() { return multiDrawIndirect != nullptr; }
+
+    // GL 4.4: immutable buffers that can stay mapped while the GPU reads them
+    static bool BufferStorage() { return bufferStorage != nullptr; }
+
+    // GL 4.1 / ARB_get_program_binary, with at least one binary format: linked
+    // programs can be saved and restored (see ProgramCache)
+    static bool ProgramBinary() { return programBinary != nullptr; }
+
+    // EXT_texture_compression_s3tc (BC1-3; BC4/5 are core as RGTC): textures are
+    // block-compressed on load
+    static bool TextureCompression() { return textureCompression; }
+
+    static PFN_glMultiDrawElementsIndirect multiDrawIndirect;
+    static PFN_glBufferStorage bufferStorage;
+    static PFN_glGetProgramBinary getProgramBinary;
+    static PFN_glProgramBinary programBinary;
+    static PFN_glProgramParameteri programParameteri;
+
+private:
+    static int major;
+    static int minor;
+    static bool textureCompression;
+};
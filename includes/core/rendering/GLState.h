@@ -0,0 +1,78 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+
+// Shadow copy of the GL state the engine touches every frame.
+// - every bind / state change goes through here, so a call that would not
+//   change anything never reaches the driver
+// - values start out "unknown", so the first call after Invalidate() is always issued
+// - code that changes GL state directly must call Invalidate() afterwards
+class GLState
+{
+public:
+    struct Stats
+    {
+        uint64_t issued = 0;    // calls forwarded to GL
+        uint64_t skipped = 0;   // redundant calls filtered out
+    };
+
+    static constexpr int MAX_TEXTURE_UNITS = 16;
+
+    // Bindings
+    static void UseProgram(GLuint program);
+    static void BindVertexArray(GLuint vao);
+    static void BindTexture(GLuint unit, GLuint texture); // GL_TEXTURE_2D
+    // Binds texture on unit 0 and leaves unit 0 active, for calls that act on the
+    // active unit's texture (uploads, glGenerateMipmap, parameters)
+    static void EditTexture(GLuint texture);
+
+    // Fixed-function state
+    static void SetDepthTest(bool enabled);
+    static void SetStencilTest(bool enabled);
+    static void SetBlend(bool enabled);
+    static void DepthMask(bool write);
+    static void DepthFunc(GLenum func);
+    static void StencilMask(GLuint mask);
+    static void StencilFunc(GLenum func, GLint ref, GLuint mask);
+    static void StencilOp(GLenum sfail, GLenum dpfail, GLenum dppass);
+    static void BlendFunc(GLenum src, GLenum dst);
+
+    // Objects about to be deleted; GL drops their bindings, so must we
+    static void ForgetProgram(GLuint program);
+    static void ForgetVertexArray(GLuint vao);
+    static void ForgetTexture(GLuint texture);
+
+    // Forget everything (e.g. after third-party code touched GL directly)
+    static void Invalidate();
+
+    static const Stats& GetStats() { return stats; }
+    static void ResetStats() { stats = Stats(); }
+
+private:
+    static bool setCap(int& cached, GLenum cap, bool enabled);
+
+    static constexpr GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    static GLuint program;
+    static GLuint vertexArray;
+    static GLuint activeUnit;
+    static GLuint textures[MAX_TEXTURE_UNITS];
+
+    // -1 = unknown, 0 = disabled, 1 = enabled
+    static int depthTest;
+    static int stencilTest;
+    static int blend;
+    static int depthWrite;
+    static GLenum depthFunc;
+
+    static GLuint stencilWriteMask;
+    static GLenum stencilFunc;
+    static GLint stencilRef;
+    static GLuint stencilFuncMask;
+    static GLenum stencilOps[3];
+
+    static GLenum blendSrc;
+    static GLenum blendDst;
+
+    static Stats stats;
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "core/rendering/StreamBuffer.h"
+
+// Vertex layouts the pool keeps separate buffers (and one VAO) for
+enum class VertexFormat : uint8_t
+{
+    Standard = 0,   // Vertex: pos(3) normal(3) uv(2), 32 bytes
+    Packed,         // PackedVertex: unorm16 pos, snorm 10_10_10_2 normal, half uv, 16 bytes
+    Count
+};
+
+// Where a mesh's data currently lives inside its format's buffers.
+// Offsets change when the pool repacks, so look them up at draw time.
+struct GeometryRange
+{
+    VertexFormat format = VertexFormat::Standard;
+    uint32_t baseVertex = 0;
+    uint32_t vertexCount = 0;   // 0 = free handle
+    uint32_t firstIndex = 0;    // in units of the index type
+    uint32_t indexCount = 0;    // 0 = non-indexed
+    uint8_t indexSize = 4;      // 2 for meshes with fewer than 65536 vertices
+    bool streamed = false;      // lives in the format's stream buffer (see AllocateStream)
+
+    GLenum IndexType() const { return indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT; }
+    // byte offset of the first index, as passed to glDrawElements*
+    const void* IndexOffset() const { return (const void*)(uintptr_t)(firstIndex * indexSize); }
+};
+
+// Suballocates vertex and index ranges for every mesh from a few large buffers:
+// one vertex buffer, index buffer and VAO per vertex format.
+// - meshes keep a handle; indices stay mesh-local and are drawn with glDrawElementsBaseVertex
+// - indices are stored as 16-bit when the mesh has fewer than 65536 vertices; both sizes
+//   share the index buffer, which is allocated in 4-byte words to keep 32-bit ranges aligned
+// - freed ranges return to a free list and merge with free neighbours
+// - a request that fits no free block repacks all live ranges to the front of the
+//   buffers (growing them if needed) with GPU-side copies; VAO names never change
+// - GL objects are created lazily on first Allocate()
+// - per-frame geometry goes to a separate StreamBuffer (and VAO) per format instead
+class GeometryPool
+{
+public:
+    static constexpr uint32_t INVALID = UINT32_MAX;
+
+    struct Stats
+    {
+        uint32_t vertexCapacity = 0;
+        uint32_t verticesUsed = 0;
+        size_t vertexBytesUsed = 0;
+        size_t indexBytesCapacity = 0;
+        size_t indexBytesUsed = 0;
+        uint32_t freeBlocks = 0;
+        uint32_t repacks = 0;
+    };
+
+    // Copy vertices (laid out as `format`) and optional indices into the pool;
+    // indices are narrowed to 16 bits when they fit
+    static uint32_t Allocate(VertexFormat format, const void* vertices, uint32_t vertexCount,
+        const uint32_t* indices, uint32_t indexCount);
+    static void Free(uint32_t handle);
+
+    // Handle for geometry rewritten every frame (debug lines, particles, CPU-skinned meshes).
+    // Each WriteStream replaces its data with a copy in the format's stream buffer (32-bit
+    // indices) that stays valid for the rest of the frame: write it every frame it is drawn.
+    // Draw it with GetStreamVertexArray(format); Free() releases the handle.
+    static uint32_t AllocateStream(VertexFormat format);
+    // false (and an empty range) if this frame's stream is full; the next frame has room
+    static bool WriteStream(uint32_t handle, const void* vertices, uint32_t vertexCount,
+        const uint32_t* indices, uint32_t indexCount);
+    static GLuint GetStreamVertexArray(VertexFormat format) { return streams[static_cast<int>(format)].vao; }
+    // Fence this frame's streamed geometry; call once per frame after its draws are issued
+    static void EndFrame();
+
+    static const GeometryRange& Get(uint32_t handle) { return ranges[handle]; }
+    static GLuint GetVertexArray(VertexFormat format) { return arenas[static_cast<int>(format)].vao; }
+
+    // Move all live ranges to the front of their buffers, leaving one free block each
+    static void Compact();
+    // Release all GL objects (GL context must be current)
+    static void Clear();
+
+    static Stats GetStats();
+
+private:
+    struct Block
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // First-fit free list over [0, capacity), sorted by offset
+    struct FreeList
+    {
+        std::vector<Block> blocks;
+        uint32_t capacity = 0;
+        uint32_t used = 0;
+
+        bool CanFit(uint32_t count) const;
+        uint32_t Allocate(uint32_t count);
+        void Free(uint32_t offset, uint32_t count);
+        bool IsPacked() const;
+        void Reset(uint32_t newCapacity, uint32_t newUsed);
+    };
+
+    struct Arena
+    {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ebo = 0;
+        FreeList vertices;
+        FreeList indices;   // in 4-byte words
+    };
+
+    // StreamBuffers are pointers so they are released in Clear(), while GL is still up
+    struct StreamArena
+    {
+        GLuint vao = 0;
+        std::unique_ptr<StreamBuffer> vertices;
+        std::unique_ptr<StreamBuffer> indices;
+        bool frameOpen = false;
+        GLuint boundVertices = 0;   // buffers the VAO points at
+        GLuint boundIndices = 0;
+    };
+
+    static void repack(VertexFormat format, uint32_t vertexCapacity, uint32_t indexCapacity);
+    static void setupAttributes(VertexFormat format);
+    static void beginStreamFrame(VertexFormat format);
+
+    static Arena arenas[static_cast<int>(VertexFormat::Count)];
+    static StreamArena streams[static_cast<int>(VertexFormat::Count)];
+    static std::vector<GeometryRange> ranges;   // by handle
+    static std::vector<uint32_t> freeHandles;
+    static uint32_t repackCount;
+};
@@ -6,6 +6,9 @@
 #include <vector>
 #include <memory>
 #include "helpers/shaderClass.h"
+#include "core/rendering/GLState.h"
+#include "core/rendering/Bounds.h"
+#include "core/rendering/GeometryPool.h"
 
 // ----------------------------------------------------------------------------
 // POD vertex
@@ -16,6 +19,18 @@ struct Vertex
     glm::vec2 TexCoords;
 };
 
+// Compressed vertex for VertexFormat::Packed (16 bytes instead of 32)
+// - position: unorm16 inside the mesh's bounding box (see Mesh::DecodeModel)
+// - normal: snorm 10_10_10_2, xyz
+// - texCoords: half floats
+struct PackedVertex
+{
+    uint16_t position[4];   // w is padding
+    uint32_t normal;
+    uint32_t texCoords;
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay 16 bytes");
+
 // ----------------------------------------------------------------------------
 // Texture type
 enum class TextureType
@@ -37,6 +52,8 @@ struct Texture
     int width = 0;
     int height = 0;
     int channels = 0;
+    // false while TextureUploader is still streaming the pixels in (bind a placeholder)
+    bool ready = true;
 
     Texture() = default;
 
@@ -45,6 +62,7 @@ struct Texture
         if (ID != 0) {
             // IMPORTANT: glDeleteTextures must be called with a valid GL context.
             // Make sure ResourceManager::Clear() (or similar) is called before the GL context is destroyed.
+            GLState::ForgetTexture(ID);
             glDeleteTextures(1, &ID);
             ID = 0;
         }
@@ -60,7 +78,10 @@ struct Texture
     }
     Texture& operator=(Texture&& other) noexcept {
         if (this != &other) {
-            if (ID) glDeleteTextures(1, &ID);
+            if (ID) {
+                GLState::ForgetTexture(ID);
+                glDeleteTextures(1, &ID);
+            }
             steal(other);
         }
         return *this;
@@ -74,6 +95,7 @@ private:
         width = other.width;
         height = other.height;
         channels = other.channels;
+        ready = other.ready;
         other.ID = 0;
     }
 };
@@ -108,36 +130,178 @@ struct Material
 };
 
 
+struct Meshlet;
+class MeshBVH;
+
+// Build options for meshes created from vertex/index data
+struct MeshOptions
+{
+    VertexFormat format = VertexFormat::Standard;
+    bool keepCpuData = false;   // keep vertices/indices after upload (picking, collision)
+    int lodLevels = 0;          // simplified levels to build, each ~half the triangles of the last
+    // if set, the index list is regrouped into meshlets (see MeshletBuilder) and they are
+    // written here; covers the full-detail level only
+    std::vector<Meshlet>* meshlets = nullptr;
+    bool buildBvh = false;      // triangle BVH for ray and box queries (see MeshBVH)
+};
+
+// CPU half of building a mesh: the geometry after reordering (and meshlet grouping,
+// LOD simplification and BVH build, as requested), ready to upload. Mesh::Prepare
+// makes one without touching GL, so it can run on a worker thread; Mesh(MeshData&&)
+// does the upload on the GL thread.
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    VertexFormat format = VertexFormat::Standard;
+    bool keepCpuData = false;
+    float lodError = 0.0f;
+    std::vector<MeshData> lods;
+    std::unique_ptr<MeshBVH> bvh;
+
+    // out of line: MeshBVH is only forward-declared here
+    MeshData();
+    ~MeshData();
+    MeshData(MeshData&&) noexcept;
+    MeshData& operator=(MeshData&&) noexcept;
+};
+
+// One level of a mesh as the geometry pool stores it: vertices already in `format`
+// (PackedVertex for Packed), plus what is needed to draw and cull them. Pointers
+// are not owned (see Mesh::Encode and MeshCache).
+struct MeshBlocks
+{
+    VertexFormat format = VertexFormat::Standard;
+    const void* vertices = nullptr;
+    uint32_t vertexCount = 0;
+    const unsigned int* indices = nullptr;
+    uint32_t indexCount = 0;
+    Bounds bounds;
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionBias = glm::vec3(0.0f);
+    float lodError = 0.0f;
+};
+
+// A run of a mesh's own index list (offsets in indices, not bytes)
+struct IndexRange
+{
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+// GPU-resident mesh.
+// - owns its GeometryPool ranges and releases them on destruction
+// - non-copyable, movable (transfers ownership)
+// - CPU-side geometry is dropped after upload unless keepCpuData is requested
 class Mesh
 {
 public:
 
+    // only filled when the mesh was built with keepCpuData (picking, collision)
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
-    Mesh() = default;
+
+    // Takes the data by move; it is freed after upload unless options.keepCpuData is set
+    Mesh(std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices,
+        const MeshOptions& options = {});
+    // Uploads geometry prepared with Prepare() (GL thread only)
+    explicit Mesh(MeshData&& data);
+    // Uploads one level as is (no lods, no BVH, no CPU data)
+    explicit Mesh(const MeshBlocks& blocks);
+    Mesh();
+    ~Mesh();
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
 
     // Creates a mesh from interleaved float data (pos(3), norm(3), uv(2))
-    static Mesh CreateFromData(const float* vertices, std::size_t bytes, int vertexCount);
+    static Mesh CreateFromData(const float* vertices, int vertexCount);
 
     static Mesh CreateFromIndexedData(const float* vertices, std::size_t vBytes,
-        const unsigned int* indices, std::size_t iBytes, int iCount);
+        const unsigned int* indices, int iCount, const MeshOptions& options = {});
+
+    // Everything the constructor does before the upload; needs no GL context.
+    // options.meshlets, if set, is written here.
+    static MeshData Prepare(std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices,
+        const MeshOptions& options = {});
+
+    // Converts vertices to the format's GPU layout. Packed vertices are written to
+    // `storage`, which must outlive the returned blocks. Falls back to Standard
+    // for meshes without bounds.
+    static MeshBlocks Encode(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+        VertexFormat format, std::vector<PackedVertex>& storage);
 
+    // Mesh for geometry that changes every frame (debug lines, particles, CPU skinning):
+    // Stream() copies new data into a per-frame stream buffer; draw it like any other mesh
+    static Mesh CreateStreaming();
+    // Replaces this frame's geometry (and bounds); call it every frame the mesh is drawn.
+    // false if the frame's stream is full (the mesh draws nothing this frame)
+    bool Stream(const Vertex* vertexData, uint32_t vertexCount,
+        const unsigned int* indexData, uint32_t indexCount);
+
+    bool HasCpuData() const { return !vertices.empty(); }
+    // Bytes of CPU geometry freed after upload by all meshes so far, whichever
+    // constructor made them (LOD levels included)
+    static size_t ReleasedCpuBytes() { return releasedCpuBytes; }
+
+    // The caller sets "model"; use DecodeModel(model) for packed meshes
     void Draw(Shader& shader, Material& material) const;
 
+    // Bind material textures and upload material uniforms (shader must already be in use)
+    static void ApplyMaterial(Shader& shader, const Material& material);
+    // Only the texture part of ApplyMaterial (material values come from elsewhere)
+    static void BindMaterialTextures(Shader& shader, const Material& material);
+
     // Draw raw geometry (assumes caller set shader and uniforms). Useful for outline pass.
     void DrawSimple() const;
 
+    // Same as DrawSimple, but draws instanceCount copies (per-instance attributes set by caller)
+    void DrawInstanced(int instanceCount) const;
+
+    // Draws only the given parts of the index list, in one glMultiDrawElementsBaseVertex call
+    void DrawRanges(const IndexRange* ranges, uint32_t rangeCount) const;
 
-    // Destroy GPU objects
+
+    // Release the mesh's ranges in the geometry pool (also done by the destructor)
     void Destroy();
 
+    // geometry lives in the shared GeometryPool; VAO is the pool's VAO for the vertex format
+    uint32_t geometry = GeometryPool::INVALID;
     unsigned int VAO = 0;
-    unsigned int VBO = 0;
-    unsigned int EBO = 0;
     int vertexCount = 0;
     int indexCount = 0;
+    VertexFormat format = VertexFormat::Standard;
+
+    // Packed positions are stored as positionBias + positionScale * [0, 1]
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionBias = glm::vec3(0.0f);
+
+    // Model matrix to draw this mesh's stored positions with (the model itself
+    // for standard meshes). Normals still use the undecoded model.
+    glm::mat4 DecodeModel(const glm::mat4& model) const;
+
+    // local-space AABB and sphere, computed on creation (used for culling)
+    Bounds bounds;
+
+    // Simplified versions of this mesh, finest first (empty unless options.lodLevels > 0)
+    std::vector<Mesh> lods;
+    // How far (object space) this level's surface may be from the full mesh
+    float lodError = 0.0f;
+
+    // Coarsest level whose error stays within maxPixels when one object-space
+    // unit covers pixelsPerUnit pixels on screen (this mesh if no level qualifies)
+    const Mesh& SelectLod(float pixelsPerUnit, float maxPixels) const;
+
+    // Triangle BVH of the full-detail level (null unless options.buildBvh)
+    std::unique_ptr<MeshBVH> bvh;
 
 private:
-    void setupMesh();
+    void setupMesh(const std::vector<Vertex>& vertexData, const std::vector<unsigned int>& indexData);
+    void upload(const MeshBlocks& blocks);
+    static void buildLods(MeshData& data, const Bounds& bounds, int levels);
+    void steal(Mesh& other) noexcept;
+
+    static size_t releasedCpuBytes;
 };
\ No newline at end of file
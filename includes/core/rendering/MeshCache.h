@@ -0,0 +1,161 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "core/MappedFile.h"
+#include "core/rendering/Mesh.h"
+#include "core/rendering/geometry/MeshletBuilder.h"
+
+// ----------------------------------------------------------------------------
+// On-disk records of a cooked model. The file is the header, the mesh, level and
+// texture tables, the texture path strings and then the data blocks; offsets are
+// from the start of the file and blocks start on 16 bytes.
+struct CacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint32_t format;
+    uint32_t lodLevels;
+    uint32_t meshletMinTriangles;
+    uint32_t buildBvh;
+    uint32_t pad;
+    uint32_t meshCount;
+    uint32_t levelCount;
+    uint32_t textureCount;
+    uint64_t meshOffset;
+    uint64_t levelOffset;
+    uint64_t textureOffset;
+    uint64_t stringOffset;
+    uint64_t stringBytes;
+};
+
+struct CacheMesh
+{
+    uint32_t firstLevel;        // full detail first, then the LODs
+    uint32_t levelCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    uint64_t meshletOffset;
+    uint64_t bvhNodeOffset;
+    uint64_t bvhPositionOffset;
+    uint64_t bvhIdOffset;
+    uint32_t meshletCount;
+    uint32_t bvhNodeCount;
+    uint32_t bvhTriangleCount;  // 0: no BVH
+    uint32_t materialFlags;     // 1: diffuse map, 2: specular map
+    glm::vec3 diffuseColor;
+    glm::vec3 specularColor;
+    float shininess;
+    uint32_t pad;
+};
+
+struct CacheLevel
+{
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t format;
+    float lodError;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+    glm::vec3 positionScale;
+    glm::vec3 positionBias;
+    uint32_t boundsValid;
+};
+
+struct CacheTexture
+{
+    uint32_t type;
+    uint32_t pathOffset;        // into the string block
+    uint32_t pathLength;
+    uint32_t pad;
+};
+
+// ----------------------------------------------------------------------------
+// Cooked model files: what an import produces, stored ready to upload, so later
+// runs skip the importer, the optimizer, LOD simplification and BVH builds.
+// - one file per source file, under CACHE_DIRECTORY, named after the source path
+// - the file records the source's size and modification time and the import
+//   options; a cache that does not match them, or whose tables or blocks point
+//   outside what they index (see validate()), is ignored and rewritten
+// - geometry blocks are in the GPU vertex format and are uploaded straight from
+//   the mapped file; meshlets, BVHs and materials are copied out of it
+class MeshCache
+{
+public:
+    static constexpr const char* CACHE_DIRECTORY = "cache/models";
+
+    // What a cache file was cooked from, and how
+    struct Key
+    {
+        uint64_t sourceSize = 0;
+        int64_t sourceTime = 0;
+        uint32_t format = 0;
+        uint32_t lodLevels = 0;
+        uint32_t meshletMinTriangles = 0;
+        uint32_t buildBvh = 0;
+    };
+
+    struct TextureRef
+    {
+        std::string path;
+        TextureType type = TextureType::Other;
+    };
+
+    // Key for the source file as it is now; false if the file cannot be read
+    static bool MakeKey(const std::string& sourcePath, VertexFormat format, int lodLevels,
+        uint32_t meshletMinTriangles, bool buildBvh, Key& key);
+    static std::string CachePath(const std::string& sourcePath);
+
+    // Maps the cache file of sourcePath; nullptr if there is none, or it is stale or damaged
+    static std::unique_ptr<MeshCache> Open(const std::string& sourcePath, const Key& key);
+
+    size_t MeshCount() const;
+
+    // Uploads a mesh (with its LODs and BVH) from the mapped file. GL thread only
+    std::shared_ptr<Mesh> CreateMesh(size_t mesh) const;
+    std::vector<Meshlet> GetMeshlets(size_t mesh) const;
+    // The material without textures; GetTextures lists them
+    Material GetMaterial(size_t mesh) const;
+    std::vector<TextureRef> GetTextures(size_t mesh) const;
+
+    // Reads the mesh's geometry pages in, so the upload does not wait on the disk
+    // (call from a loader thread)
+    void Prefetch(size_t mesh) const;
+
+    // Collects the meshes of an import and writes them as a cache file
+    class Writer
+    {
+    public:
+        // data as returned by Mesh::Prepare (before it is uploaded)
+        void Add(const MeshData& data, const std::vector<Meshlet>& meshlets,
+            const Material& material, const std::vector<TextureRef>& textures);
+        // false (and prints why) if the file cannot be written
+        bool Save(const std::string& sourcePath, const Key& key) const;
+
+    private:
+        size_t append(const void* bytes, size_t size);
+
+        std::vector<unsigned char> blocks;  // geometry, meshlets and BVHs
+        std::vector<CacheMesh> meshes;
+        std::vector<CacheLevel> levels;
+        std::vector<CacheTexture> textures;
+        std::string strings;                // texture paths
+    };
+
+private:
+    MeshCache() = default;
+
+    template <typename T>
+    const T* at(uint64_t offset) const { return reinterpret_cast<const T*>(file.Data() + offset); }
+    bool validate() const;
+
+    MappedFile file;
+    const CacheHeader* header = nullptr;
+};
@@ -1,33 +1,109 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <memory>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include "helpers/shaderClass.h";
 #include "core/rendering/Mesh.h"
+#include "core/rendering/geometry/MeshletBuilder.h"
+#include "core/rendering/MeshCache.h"
 
 struct MeshEntry {
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
+	// clusters of mesh's full-detail index list, culled per frame by the renderer
+	// (empty for small meshes, which are cheaper to draw whole)
+	std::vector<Meshlet> meshlets;
 };
 
+// How far a model's load has got
+enum class ModelState
+{
+	Pending,	// nothing uploaded yet (draws nothing)
+	Partial,	// some meshes uploaded and drawn, more to come
+	Ready,		// every mesh uploaded
+	Failed		// the import failed (the model stays empty)
+};
+
+enum class LoadMode
+{
+	Blocking,	// the constructor returns with the model ready
+	Async		// import on a thread; meshes appear as UploadPending() uploads them
+};
+
+// Loading is split in two stages:
+// - CPU: Assimp import, vertex conversion and Mesh::Prepare (reordering, meshlets, LODs,
+//   BVH if asked for), texture decode (fanned out to the ImageDecoder pool). The result is cooked
+//   into a MeshCache file, which replaces all but the texture decode while the source
+//   file is unchanged. Async models run this stage on their own thread
+// - GL: texture and geometry uploads, on the GL thread. Async models are uploaded a few
+//   meshes at a time by UploadPending(), once per frame, within a time budget
+// Async models must not be copied or moved (the loader thread points at them).
 class Model
 {
 public:
-	Model(const std::string& path)
-	{
-		loadModel(path);
-	}
+	// simplified levels built for every imported mesh
+	static constexpr int MODEL_LOD_LEVELS = 4;
+	// imported meshes with at least this many triangles are split into meshlets
+	static constexpr unsigned int MODEL_MESHLET_MIN_TRIANGLES = 1024;
+
+	// time UploadPending() is given per frame by the main loop
+	static constexpr double UPLOAD_BUDGET_MS = 4.0;
+
+	// imported meshes are stored packed by default (half the vertex memory of Standard).
+	// buildBvh: triangle BVHs for picking and collision; without them SceneBVH hits the
+	// model's meshes on their bounds (a BVH costs ~36 bytes per triangle and build time)
+	Model(const std::string& path, VertexFormat format = VertexFormat::Packed,
+		LoadMode mode = LoadMode::Blocking, bool buildBvh = false);
+	~Model();
+
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
+	// Uploads prepared meshes of every async model still loading until budgetMs has
+	// passed (at least one mesh per call). GL thread only; call once per frame.
+	static void UploadPending(double budgetMs);
+
+	ModelState GetState() const { return state; }
 	size_t GetMeshCount() const { return meshes.size(); }
-	void Draw(Shader& shader);
+	const std::vector<MeshEntry>& GetMeshes() const { return meshes; }
+	// union of all sub-mesh bounds (local space); grows while a model is loading
+	const Bounds& GetBounds() const { return bounds; }
+	// no Draw(): models are drawn through an Entity's modelRenderer, so the Renderer
+	// applies each mesh's decode transform (Mesh::DecodeModel) for Packed meshes
 private:
+	struct PendingTexture;
+	struct PendingMesh;
+	struct Loader;
+
 	// model data
 	std::vector<MeshEntry> meshes;
+	Bounds bounds;
+	VertexFormat format;
+	bool buildBvh;
+	std::string path;
 	std::string directory;
-	void loadModel(std::string path);
+	ModelState state = ModelState::Pending;
+	size_t releasedBytes = 0;
+	std::unique_ptr<Loader> loader;	// only while loading
+
+	// async models still loading (GL thread only)
+	static std::vector<Model*> loading;
+
+	// CPU stage (loader thread for async models)
+	void importModel();
+	bool importCached(const MeshCache::Key& key);
+	PendingTexture decodeTexture(const std::string& texturePath, TextureType type);
 	void processNode(aiNode* node, const aiScene* scene);
-	MeshEntry processMesh(aiMesh* mesh, const aiScene* scene);
-	std::vector<std::shared_ptr<Texture>> loadMaterialTextures(aiMaterial* mat,
-		aiTextureType type, TextureType typeName);
+	void processMesh(aiMesh* mesh, const aiScene* scene);
+	void loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType typeName,
+		std::vector<PendingTexture>& textures);
+
+	// GL stage
+	// false once nothing is queued, or (unless wait) the next mesh's textures are still decoding
+	bool uploadNext(bool wait);
+	bool loadFinished() const;
+	void finishLoad();
 };
@@ -0,0 +1,40 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+// Linked shader programs saved as driver binaries (glGetProgramBinary), so later runs
+// restore them with glProgramBinary instead of compiling and linking from source.
+// - one file per program under CACHE_DIRECTORY, named after its key
+// - the key covers both final sources (defines already injected, see Shader) and the
+//   GL vendor, renderer and version strings; a new driver misses the old files
+// - a binary the driver rejects is ignored; the program compiles from source and
+//   its file is rewritten
+// - only used when GLCaps::ProgramBinary(); GL thread only
+class ProgramCache
+{
+public:
+    static constexpr const char* CACHE_DIRECTORY = "cache/shaders";
+
+    static bool Enabled();
+    static uint64_t MakeKey(const std::string& vertexCode, const std::string& fragmentCode);
+
+    // A linked program restored from the cache; 0 if there is none or the driver rejects it
+    static GLuint Load(uint64_t key);
+    // Call before glLinkProgram on programs that will be saved
+    static void PrepareForSave(GLuint program);
+    // Stores a linked program; false (and prints why) if it cannot be written
+    static bool Save(uint64_t key, GLuint program);
+
+    // Programs restored / compiled and saved so far
+    static unsigned Restored() { return restored; }
+    static unsigned Saved() { return saved; }
+
+private:
+    // "vendor | renderer | version" of the current context
+    static const std::string& driver();
+    static std::string cachePath(uint64_t key);
+
+    static unsigned restored;
+    static unsigned saved;
+};
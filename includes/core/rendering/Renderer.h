@@ -1,25 +1,208 @@
 #pragma once
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 #include "helpers/shaderClass.h"
 #include "core/rendering/Mesh.h"
+#include "core/rendering/UniformBuffer.h"
+#include "core/rendering/StreamBuffer.h"
+#include "core/rendering/Frustum.h"
+#include "core/rendering/GLCaps.h"
 
 class Model;
+struct Meshlet;
+class LightManager;
 
-class Renderer 
+// Passes are flushed in this order (highest bits of the sort key)
+enum class RenderPass : uint8_t
+{
+    Opaque = 0,     // regular geometry, no stencil writes
+    Outlined = 1,   // outlined objects, write stencil = 1
+    Outline = 2     // outline rims, drawn where stencil != 1
+};
+
+// A single recorded draw. Submissions only record these; GL work happens in EndScene.
+struct RenderCommand
+{
+    glm::mat4 model;
+    const Mesh* mesh = nullptr;
+    Shader* shader = nullptr;
+    const Material* material = nullptr;
+    uint32_t object = UINT32_MAX;   // culling volume (UINT32_MAX = never culled)
+
+    // clusters of the mesh (full-detail level only); if set, only the index ranges
+    // of the clusters that survive culling are drawn
+    const std::vector<Meshlet>* meshlets = nullptr;
+    uint32_t firstRange = 0;        // into the frame's meshlet ranges
+    uint32_t rangeCount = 0;
+};
+
+// Frustum culling counters for the last frame (objects = submissions, not draws)
+struct CullStats
+{
+    uint32_t tested = 0;
+    uint32_t culled = 0;
+    // clusters of visible submissions, rejected by frustum (or normal cone, if enabled)
+    uint32_t meshletsTested = 0;
+    uint32_t meshletsCulled = 0;
+};
+
+// std140 mirror of the "Camera" uniform block declared by the engine shaders
+struct CameraBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;
+    float padding = 0.0f;
+};
+
+// Per-instance data streamed for instanced draws (matches the *Instanced.vs layouts)
+struct InstanceData
+{
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+    uint32_t material = 0;  // index into the Materials storage buffer (multi-draw path)
+};
+
+// std430 mirror of MaterialData in modularFragmentShader.fs (multi-draw path)
+struct GPUMaterial
+{
+    glm::vec4 diffuseColor;
+    glm::vec4 specularColor;    // w = shininess
+};
+
+class Renderer
 {
 public:
-    void BeginScene(const glm::mat4& view, const glm::mat4& projection, 
-        const glm::vec3& viewPos);
+    Renderer() = default;
+
+    // owns GL buffers
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    // viewportHeight: pixels (the window's, as tracked by its resize callback), for LOD selection
+    void BeginScene(const glm::mat4& view, const glm::mat4& projection,
+        const glm::vec3& viewPos, float viewportHeight);
+    // Lights uploaded to the shared Lights uniform block before the frame is drawn
+    void SetLights(LightManager& lights);
     void SubmitMesh(const glm::mat4& model,
         const Mesh& mesh,
         const std::shared_ptr<Shader>& shader, const std::shared_ptr<Material>& mat);
-    void SubmitModel(const glm::mat4& model, Model& modelObj, 
+    void SubmitModel(const glm::mat4& model, Model& modelObj,
         const std::shared_ptr<Shader>& shader);
+    // Culls, sorts the queued commands and issues them
     void EndScene();
 
+    const CullStats& GetCullStats() const { return cullStats; }
+
+    // Merge opaque draws into glMultiDrawElementsIndirect calls when GL 4.3 is
+    // available (on by default); otherwise the GL 3.3 path is used
+    void SetMultiDraw(bool enabled) { multiDrawEnabled = enabled; }
+    bool UsesMultiDraw() const;
+
+    // Per-cluster frustum culling of models imported with meshlets (on by default)
+    void SetMeshletCulling(bool enabled) { meshletCullingEnabled = enabled; }
+    // Also reject clusters facing away from the camera (off by default). Only valid
+    // for closed, one-sided surfaces drawn with GL_CULL_FACE, which the engine does not enable
+    void SetMeshletConeCulling(bool enabled) { meshletConeCullingEnabled = enabled; }
+
+    // Meshes with LOD levels are drawn at the coarsest level whose simplification
+    // error projects to at most this many pixels (0 = always full detail)
+    void SetLodThreshold(float pixels) { lodMaxPixels = pixels; }
+
 private:
+    // Compact sort entry: commands themselves are never moved while sorting
+    struct SortItem
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    // A run of sorted items drawn with one call
+    struct DrawBatch
+    {
+        uint32_t first;          // into sortItems
+        uint32_t count;
+        Shader* instancedShader = nullptr; // nullptr = draw items one by one
+        uint32_t firstInstance = 0;        // into instanceData
+        bool multiDraw = false;            // part of a glMultiDrawElementsIndirect group
+        uint32_t command = 0;              // into indirectCommands
+        uint32_t commandCount = 1;         // more than one when meshlet ranges are drawn
+    };
+
+    uint32_t addObject(const Bounds& bounds, const glm::mat4& model);
+    const Mesh& selectLod(const Mesh& mesh, const Bounds& bounds, const glm::mat4& model) const;
+    void queue(RenderPass pass, const glm::mat4& model, const Mesh& mesh,
+        Shader* shader, const Material* mat, uint32_t object,
+        const std::vector<Meshlet>* meshlets = nullptr);
+    void cull();
+    void cullMeshlets();
+    uint32_t cullMeshletsOf(const RenderCommand& cmd, std::vector<IndexRange>& ranges) const;
+    void specialize();
+    Shader* shaderVariant(Shader* base, const Material* mat, int numPoint, int numSpot);
+    uint64_t makeKey(RenderPass pass, const Shader& shader, const Material* mat,
+        const Mesh& mesh, const glm::mat4& model);
+    uint16_t materialId(const Material* mat);
+    void buildBatches();
+    void uploadInstances();
+    void uploadMultiDraw();
+    void bindInstanceAttributes(const Mesh& mesh, uint32_t firstInstance);
+    Shader* instancedVariant(Shader* shader);
+    Shader* multiDrawVariant(Shader* shader);
+    void flush();
+
     glm::mat4 viewMatrix;
     glm::mat4 projMatrix;
     glm::vec3 viewPosition;
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+    // pixels covered by one world unit at distance 1 (LOD selection)
+    float lodScale = 0.0f;
+    float lodMaxPixels = 1.0f;
+
+    LightManager* lights = nullptr;
+
+    // written once per frame in BeginScene
+    UniformRingBuffer cameraBuffer{ UniformBinding::Camera, sizeof(CameraBlock) };
+
+    // world boxes of this frame's submissions, tested together in EndScene
+    Frustum frustum;
+    BoxList objectBoxes;
+    std::vector<uint8_t> objectVisible;
+    CullStats cullStats;
+
+    bool meshletCullingEnabled = true;
+    bool meshletConeCullingEnabled = false;
+    std::vector<uint32_t> meshletCommands;                // commands with clusters, this frame
+    std::vector<std::vector<IndexRange>> meshletScratch;  // surviving ranges per such command
+    std::vector<IndexRange> meshletRanges;                // all of them, indexed by firstRange
+
+    std::vector<RenderCommand> commands;
+    std::vector<SortItem> sortItems;
+    std::vector<DrawBatch> batches;
+    // material pointer -> dense id, rebuilt every frame; equal materials share an id
+    std::unordered_map<const Material*, uint16_t> materialIds;
+    std::vector<const Material*> uniqueMaterials;
+
+    std::vector<InstanceData> instanceData;
+    // per-frame streams: written in EndScene, fenced once the frame's draws are issued
+    StreamBuffer instanceStream{ 64 * 1024 };
+    size_t instanceOffset = 0;
+    std::unordered_map<const Shader*, std::shared_ptr<Shader>> instancedShaders;
+
+    // multi-draw path: one indirect command per batch, material values in a storage buffer
+    bool multiDrawEnabled = true;
+    std::vector<DrawElementsIndirectCommand> indirectCommands;
+    std::vector<GPUMaterial> gpuMaterials;
+    StreamBuffer indirectStream{ 16 * 1024 };
+    size_t indirectOffset = 0;
+    StreamBuffer materialStream{ 16 * 1024 };
+    std::unordered_map<const Shader*, std::shared_ptr<Shader>> multiDrawShaders;
+    // (base program, feature bits) -> program compiled for those features
+    std::map<std::pair<const Shader*, uint32_t>, std::shared_ptr<Shader>> shaderVariants;
+
+    std::shared_ptr<Shader> outlineShader;
 };
@@ -0,0 +1,57 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+
+// Buffer for data rewritten every frame (instances, indirect commands, dynamic geometry).
+// Writes of one frame are appended between BeginFrame() and EndFrame().
+// - GL 4.4: one immutable buffer, persistently mapped for its whole life and split into
+//   `frameCount` regions; each frame writes its own region with a plain memcpy. EndFrame()
+//   fences the region and BeginFrame() waits on that fence before the region comes round
+//   again, so the driver never has to synchronize behind our back
+// - GL 3.3: BeginFrame() orphans the buffer (glBufferData with no data) and writes go in
+//   with glBufferSubData, into storage the GPU is not reading
+// - neither path reallocates during a frame: a write that does not fit fails, and the next
+//   BeginFrame() grows the frame size to the largest frame seen so far
+// - the buffer name changes when it grows, so bind Buffer() again every frame
+// - GL objects are created lazily on the first BeginFrame()
+class StreamBuffer
+{
+public:
+    static constexpr size_t FULL = ~size_t(0);
+
+    explicit StreamBuffer(size_t frameBytes, int frameCount = 3);
+    ~StreamBuffer();
+
+    // non-copyable (owns GL buffer and fences)
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Starts a frame with room for at least `bytes` (waits for the region if the GPU still reads it)
+    void BeginFrame(size_t bytes = 0);
+    // Copies data in at the next multiple of `alignment`; returns its byte offset
+    // in Buffer(), or FULL if the frame has no room left
+    size_t Write(const void* data, size_t bytes, size_t alignment = 16);
+    // Fences the frame's region (once its draws are issued)
+    void EndFrame();
+
+    GLuint Buffer() const { return buffer; }
+    bool Persistent() const { return mapped != nullptr; }
+    // bytes written so far this frame
+    size_t Used() const { return head - regionStart; }
+
+private:
+    static constexpr int MAX_FRAMES = 4;
+
+    void create(size_t bytes);
+    void release();
+
+    size_t frameBytes;
+    int frameCount;
+    int region = 0;
+    size_t regionStart = 0;
+    size_t head = 0;
+    size_t peak = 0;            // largest frame requested so far, including failed writes
+    GLuint buffer = 0;
+    char* mapped = nullptr;     // persistent mapping of the whole buffer (GL 4.4 path)
+    GLsync fences[MAX_FRAMES] = {};
+};
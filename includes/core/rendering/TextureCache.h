@@ -0,0 +1,33 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include "core/ImageDecoder.h"
+
+// Block-compressed textures cooked from image files, so later runs skip decoding
+// and mip generation.
+// - one file per source image, next to it: "<source>.ktx", in the KTX 1.1 layout
+//   (the rows are bottom-up, as GL takes them, and marked so with KTXorientation)
+// - the file records the source's size and modification time and the encoder
+//   version; a file that does not match them is ignored and rewritten
+// - no GL calls; any thread
+class TextureCache
+{
+public:
+    // bump whenever the encoder or the mip filter changes its output
+    static constexpr int VERSION = 2;
+
+    static std::string CachePath(const std::string& sourcePath);
+
+    // Reads the file cooked from sourcePath; false if there is none, or it is stale or damaged
+    static bool Load(const std::string& sourcePath, CompressedImage& image);
+    // false (and prints why) if the file cannot be written
+    static bool Save(const std::string& sourcePath, const CompressedImage& image);
+
+    // GL formats of the blocks (see GLCaps for the S3TC enums)
+    static GLenum InternalFormat(BlockFormat format);
+    static GLenum BaseFormat(BlockFormat format);
+
+private:
+    // what the cooked file must record for the source as it is now; empty if it cannot be read
+    static std::string sourceStamp(const std::string& sourcePath);
+};
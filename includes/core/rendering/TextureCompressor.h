@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "core/ImageDecoder.h"
+
+// CPU block compression for textures, run once per source file (see TextureCache).
+// - mips are filtered on the CPU with a tent filter spanning four texels of the
+//   finer level ([1 3 3 1] / 8 for even sizes), wrapping around the edges like
+//   GL_REPEAT. Each level is made from the one above in 8 bits per channel and
+//   the stored values are averaged as they are, like glGenerateMipmap (nothing
+//   is sampled as sRGB)
+// - BC1 endpoints come from the block's principal axis, refined once by least
+//   squares; single channels (BC3 alpha, BC4, both halves of BC5) use the block's
+//   min and max with the 8-value palette
+// - filtering and Encode() spread rows (of texels, of blocks) over the JobSystem
+//   workers; that is parallel when called on the JobSystem's owner thread; on the
+//   ImageDecoder threads whole files are compressed side by side instead
+namespace TextureCompressor
+{
+    struct MipLevel
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> rgba;    // 4 bytes per texel, rows bottom-up
+    };
+
+    size_t BlockBytes(BlockFormat format);
+    size_t EncodedSize(BlockFormat format, int width, int height);
+
+    // By channel count, like the uncompressed formats: BC4 for one channel (red),
+    // BC5 for two (red, green), BC1 for opaque colour, BC3 when any alpha is below 255
+    BlockFormat ChooseFormat(const ImageData& image);
+
+    // Every level down to 1x1, full size first (expanded to RGBA as ChooseFormat reads it)
+    std::vector<MipLevel> BuildMips(const ImageData& image);
+
+    // rgba: width * height texels; blocks: EncodedSize(format, width, height) bytes.
+    // Edge blocks of sizes that are not multiples of 4 repeat the last row / column
+    void Encode(BlockFormat format, const unsigned char* rgba, int width, int height,
+        unsigned char* blocks);
+
+    // Format choice, mip chain and encoding of every level
+    CompressedImage Compress(const ImageData& image);
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "core/ImageDecoder.h"
+#include "core/rendering/StreamBuffer.h"
+
+struct Texture;
+
+// Streams decoded images into textures without stalling the frame.
+// - Queue() takes a texture whose storage exists; Update() copies the next rows of
+//   queued images into a StreamBuffer used as a ring of pixel unpack buffers and
+//   transfers them with glTexSubImage2D, at most the frame budget per frame
+// - compressed images go the same way, level by level, in rows of 4x4 blocks
+//   (glCompressedTexSubImage2D); uncompressed ones get their mips from the GL
+// - after its last rows a texture gets a fence; it is marked ready
+//   (Texture::ready) by the first Update() that finds the fence signalled
+// - until then materials sample Placeholder() in its place
+// - GL thread only
+class TextureUploader
+{
+public:
+    static constexpr size_t DEFAULT_FRAME_BUDGET = 8 * 1024 * 1024;
+
+    static void Queue(const std::shared_ptr<Texture>& texture,
+        const std::shared_ptr<const ImageDecoder::Job>& source);
+
+    // Once per frame: retires signalled uploads, then uploads up to the budget
+    static void Update();
+    // Uploads everything queued right away, bypassing the budget (blocking loads)
+    static void Flush();
+
+    static void SetFrameBudget(size_t bytes) { frameBudget = bytes; }
+    static bool Idle() { return queue.empty() && fenced.empty(); }
+
+    // 1x1 white texture bound in place of textures that are not ready
+    static GLuint Placeholder();
+
+    // GL format of decoded images with this many channels (1 to 4 bytes per texel),
+    // used as the internal format of their textures too
+    static GLenum PixelFormat(int channels);
+
+    // Drops pending uploads and the GL objects (GL context must be current)
+    static void Clear();
+
+private:
+    struct Upload
+    {
+        std::shared_ptr<Texture> texture;
+        std::shared_ptr<const ImageDecoder::Job> source;
+        int level = 0;
+        int nextRow = 0;
+    };
+    // The current level of an upload as rows: of texels, or of blocks when compressed
+    struct Rows
+    {
+        const unsigned char* data;
+        size_t rowBytes;
+        int count;
+    };
+    struct Fenced
+    {
+        std::shared_ptr<Texture> texture;
+        GLsync fence = nullptr;
+    };
+
+    static Rows rowsOf(const Upload& upload);
+    static int levelCount(const Upload& upload);
+    // uploads rows [first, first + count) of the current level, from `pixels` (a client
+    // pointer, or an offset into the bound unpack buffer)
+    static void uploadRows(const Upload& upload, const Rows& rows, int first, int count,
+        const void* pixels);
+    static void finish(Upload& upload, bool fence);
+
+    static std::deque<Upload> queue;
+    static std::vector<Fenced> fenced;
+    static std::unique_ptr<StreamBuffer> staging;
+    static size_t frameBudget;
+    static GLuint placeholder;
+};
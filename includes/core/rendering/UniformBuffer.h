@@ -0,0 +1,53 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+
+// Fixed binding points shared by every engine shader (see Shader::Shader)
+namespace UniformBinding
+{
+    constexpr GLuint Camera = 0;
+    constexpr GLuint Lights = 1;
+}
+
+// Shader storage binding points (GL 4.3 paths only, set with layout(binding) in the shader)
+namespace StorageBinding
+{
+    constexpr GLuint Materials = 0;
+}
+
+// Uniform buffer split into a small ring of slots.
+// - each Write() goes to the next slot, so the CPU never overwrites data the GPU may still read
+// - a fence per slot (placed with Fence() once the frame's draws are issued) is waited on
+//   before that slot is reused; with 3 slots this practically never blocks
+// - GL objects are created lazily on first Write(), so it can live in objects built before GL is up
+class UniformRingBuffer
+{
+public:
+    UniformRingBuffer(GLuint bindingPoint, std::size_t blockSize, int slotCount = 3);
+    ~UniformRingBuffer();
+
+    // non-copyable (owns GL buffer and fences)
+    UniformRingBuffer(const UniformRingBuffer&) = delete;
+    UniformRingBuffer& operator=(const UniformRingBuffer&) = delete;
+
+    // Copy one block into the next slot and bind it to the binding point
+    void Write(const void* data);
+    // Re-bind the most recently written slot
+    void Bind() const;
+    // Mark the current slot as in use by the commands issued so far
+    void Fence();
+
+private:
+    static constexpr int MAX_SLOTS = 4;
+
+    void create();
+    void waitForSlot(int slot);
+
+    GLuint binding;
+    std::size_t blockSize;
+    std::size_t slotStride = 0;
+    int slotCount;
+    int current = -1;
+    GLuint buffer = 0;
+    GLsync fences[MAX_SLOTS] = {};
+};
@@ -0,0 +1,94 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Mesh;
+struct Vertex;
+
+// ----------------------------------------------------------------------------
+// Ray queries (picking, line of sight)
+struct Ray
+{
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);  // need not be normalized
+    float tMax = FLT_MAX;                                // hits are at origin + t * direction
+};
+
+struct RayHit
+{
+    float t = FLT_MAX;
+    uint32_t entity = UINT32_MAX;       // set by SceneBVH
+    const Mesh* mesh = nullptr;         // set by SceneBVH
+    uint32_t triangle = UINT32_MAX;     // index / 3 into the mesh's final index list
+    glm::vec2 barycentric = glm::vec2(0.0f);   // weights of the triangle's 2nd and 3rd vertex
+};
+
+// Bounding volume hierarchy over axis-aligned boxes, built with binned SAH.
+// Nodes are 32 bytes; the children of an interior node are stored next to each other.
+namespace BVH
+{
+    struct Node
+    {
+        glm::vec3 min;
+        uint32_t leftOrFirst;   // interior: left child (right = left + 1); leaf: first primitive
+        glm::vec3 max;
+        uint32_t count;         // primitives in the leaf, 0 for interior nodes
+
+        bool IsLeaf() const { return count > 0; }
+    };
+
+    // Nodes deeper than SAH_DEPTH split at the median instead of by SAH (which can
+    // peel off one primitive at a time). Halving 2^32 primitives takes 32 levels,
+    // so no node is deeper than MAX_DEPTH and a traversal stack of STACK_SIZE
+    // entries (one sibling per level, plus both children of the current node) is enough.
+    constexpr uint32_t SAH_DEPTH = 24;
+    constexpr uint32_t MAX_DEPTH = SAH_DEPTH + 32;
+    constexpr int STACK_SIZE = MAX_DEPTH + 2;
+
+    // Builds nodes over `count` primitive boxes, at most MAX_DEPTH levels deep.
+    // `order` receives the primitive indices in leaf order (leaves index into it).
+    // Large builds are spread over the JobSystem: the top splits bin in parallel,
+    // the subtrees below them are built on separate threads.
+    void Build(const glm::vec3* boxMin, const glm::vec3* boxMax, uint32_t count, uint32_t maxLeafSize,
+        std::vector<Node>& nodes, std::vector<uint32_t>& order);
+
+    // 1 / direction, with zero components nudged so slab tests stay finite
+    glm::vec3 InverseDirection(const glm::vec3& direction);
+
+    // Entry distance into the node, or FLT_MAX if the ray misses it before tMax
+    float IntersectNode(const Node& node, const glm::vec3& origin, const glm::vec3& invDirection, float tMax);
+}
+
+// ----------------------------------------------------------------------------
+// Triangle BVH of one mesh in object space. Keeps its own copy of the triangles
+// (36 bytes each, in leaf order), so it works for meshes that dropped their CPU data.
+class MeshBVH
+{
+public:
+    MeshBVH(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+    // Restores a BVH saved from Nodes()/Positions()/Ids() (see MeshCache)
+    MeshBVH(const BVH::Node* nodes, size_t nodeCount, const glm::vec3* positions,
+        const uint32_t* ids, size_t triangleCount);
+
+    // Closest hit nearer than hit.t; fills t, triangle and barycentric
+    bool Raycast(const Ray& ray, RayHit& hit) const;
+    // Any hit before ray.tMax (occlusion / line of sight)
+    bool RaycastAny(const Ray& ray) const;
+    // Triangles whose bounds overlap the box (collision broad phase)
+    void QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& triangles) const;
+
+    size_t TriangleCount() const { return ids.size(); }
+    size_t MemoryBytes() const;
+
+    const std::vector<BVH::Node>& Nodes() const { return nodes; }
+    const std::vector<glm::vec3>& Positions() const { return positions; }
+    const std::vector<uint32_t>& Ids() const { return ids; }
+
+private:
+    std::vector<BVH::Node> nodes;
+    std::vector<glm::vec3> positions;   // 3 per triangle, leaf order
+    std::vector<uint32_t> ids;          // original triangle index per leaf slot
+};
@@ -1,14 +1,21 @@
 #pragma once
+#include <memory>
 #include <vector>
 #include <glm/glm.hpp>
 #include "core/rendering/Mesh.h"
 
+// Primitives are interned by shape and parameters: asking twice for the same
+// shape returns the same mesh (one set of pool ranges, so draws of it can be
+// instanced). The cache holds weak references; a mesh is freed with its last user.
 namespace GeometryFactory
 {
-    Mesh CreateCube(float size = 1.0f);
-    Mesh CreatePlane(float size = 1.0f);
-    Mesh CreateSphere(float radius = 1.0f, int segments = 32, int rings = 16);
-    Mesh CreateCylinder(float radius = 1.0f, float height = 2.0f, int segments = 32);
-    Mesh CreateCone(float radius = 1.0f, float height = 2.0f, int segments = 32);
-    Mesh CreateTorus(float radius = 1.0f, float tubeRadius = 0.3f, int segments = 32, int rings = 16);
+    std::shared_ptr<Mesh> CreateCube(float size = 1.0f);
+    std::shared_ptr<Mesh> CreatePlane(float size = 1.0f);
+    std::shared_ptr<Mesh> CreateSphere(float radius = 1.0f, int segments = 32, int rings = 16);
+    std::shared_ptr<Mesh> CreateCylinder(float radius = 1.0f, float height = 2.0f, int segments = 32);
+    std::shared_ptr<Mesh> CreateCone(float radius = 1.0f, float height = 2.0f, int segments = 32);
+    std::shared_ptr<Mesh> CreateTorus(float radius = 1.0f, float tubeRadius = 0.3f, int segments = 32, int rings = 16);
+
+    // Number of distinct primitives currently alive
+    size_t CachedCount();
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "core/rendering/Mesh.h"
+
+// Index/vertex reordering run on every mesh before upload.
+// 1. vertex cache: triangles reordered with Tipsify (Sander, Nehab & Barczak 2007)
+//    for a FIFO post-transform cache of CACHE_SIZE entries
+// 2. overdraw: Tipsify's clusters are sorted so outward-facing parts draw first
+//    (clusters are split further while that costs little cache efficiency)
+// 3. vertex fetch: vertices renumbered in first-use order, unused ones dropped
+namespace MeshOptimizer
+{
+    constexpr int CACHE_SIZE = 16;
+
+    struct Report
+    {
+        size_t triangles = 0;
+        float acmrBefore = 0.0f;    // average cache misses per triangle (0.5 best, 3 worst)
+        float acmrAfter = 0.0f;
+        bool optimized = false;     // false if the data was not a valid triangle list
+    };
+
+    float ComputeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+        int cacheSize = CACHE_SIZE);
+
+    // Returns the first triangle of every cluster (cache restarts) in the new order
+    std::vector<uint32_t> OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount,
+        int cacheSize = CACHE_SIZE);
+
+    // positionStride in floats. threshold: how much worse than its cluster's ACMR
+    // a split-off piece may be
+    void OptimizeOverdraw(uint32_t* indices, size_t indexCount,
+        const float* positions, size_t positionStride, size_t vertexCount,
+        const std::vector<uint32_t>& clusters, float threshold = 1.05f, int cacheSize = CACHE_SIZE);
+
+    // vertexSize in bytes. Returns the new vertex count.
+    size_t OptimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize,
+        uint32_t* indices, size_t indexCount);
+
+    // All three passes on standard vertices
+    Report Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+}
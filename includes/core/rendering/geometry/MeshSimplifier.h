@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "core/rendering/Mesh.h"
+
+// Quadric error edge-collapse simplification (Garland & Heckbert 1997).
+// Vertices are only ever collapsed onto a neighbour, never moved, so the result
+// indexes the input vertex array and keeps its normals and UVs.
+// Vertices on open borders, on attribute seams (one position, several vertices)
+// and on non-manifold edges are locked so the outline and texturing hold.
+namespace MeshSimplifier
+{
+    // Collapses the cheapest edges first until at most targetIndexCount indices remain,
+    // or the next collapse would move the surface by more than maxError.
+    // Returns the largest error introduced (object-space distance).
+    float Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+        size_t targetIndexCount, float maxError, std::vector<unsigned int>& result);
+}
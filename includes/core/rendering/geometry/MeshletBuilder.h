@@ -0,0 +1,38 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "core/rendering/Mesh.h"
+
+// A small cluster of a mesh's triangles, culled as a unit every frame.
+// Its triangles are one contiguous run of the mesh's index list.
+struct Meshlet
+{
+    uint32_t firstIndex = 0;    // relative to the mesh's own index list
+    uint32_t indexCount = 0;
+
+    // object-space bounding sphere
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // normal cone: every face normal lies within the cone around coneAxis, and
+    // coneCutoff is the sine of its half-angle. The cluster faces away from an eye when
+    //   dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius
+    // coneCutoff >= 1: the normals spread too far for a useful cone
+    glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    float coneCutoff = 1.0f;
+};
+
+// Splits a triangle list into meshlets of at most MAX_VERTICES unique vertices and
+// MAX_TRIANGLES triangles. Clusters grow from a seed triangle through shared
+// vertices (fewest new vertices first), seeds are taken in the existing index
+// order, so the post-transform cache order from MeshOptimizer mostly survives.
+namespace MeshletBuilder
+{
+    constexpr uint32_t MAX_VERTICES = 64;
+    constexpr uint32_t MAX_TRIANGLES = 124;
+
+    // Reorders `indices` so every meshlet is contiguous and returns the meshlets
+    std::vector<Meshlet> Build(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+}
@@ -2,15 +2,20 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 class Shader {
 public:
     unsigned int ID;
 
-    // Constructor
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // Constructor. Each define ("NAME" or "NAME=VALUE") is injected into both stages
+    // right after their #version line; GLSL_VERSION=<n> replaces that line instead.
+    // Programs linked on an earlier run are restored from ProgramCache when the driver allows.
+    Shader(const char* vertexPath, const char* fragmentPath,
+        const std::vector<std::string>& defines = {});
     ~Shader();
 
     // Delete copy, allow move
@@ -21,18 +26,33 @@ public:
 
     void use() const;
 
+    // Source files this program was built from
+    const std::string& GetVertexPath() const { return vertexPath; }
+    const std::string& GetFragmentPath() const { return fragmentPath; }
+    // Defines this program was compiled with
+    const std::vector<std::string>& GetDefines() const { return defines; }
+    bool HasDefine(const std::string& name) const;
+
     // Uniform setters
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
     void setFloat(const std::string& name, float value) const;
+    void setMat3(const std::string& name, const glm::mat3& value) const;
     void setMat4(const std::string& name, const glm::mat4& value) const;
     void setVec3(const std::string& name, const glm::vec3& value) const;
     void setVec3(const std::string& name, float x, float y, float z) const;
 
 private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> defines;
     mutable std::unordered_map<std::string, int> uniformCache;
 
     int getUniformLocation(const std::string& name) const;
+    void bindUniformBlock(const char* blockName, unsigned int binding) const;
+    static std::string injectDefines(const std::string& code, const std::vector<std::string>& defines);
+    // compiles and links from source; saves the binary when cacheKey is given
+    unsigned int buildProgram(const char* vShaderCode, const char* fShaderCode, const uint64_t* cacheKey) const;
     unsigned int compileShader(unsigned int type, const char* code) const;
     void checkCompileErrors(unsigned int shader, const std::string& type) const;
 };
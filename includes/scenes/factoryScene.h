@@ -48,7 +48,8 @@ private:
     // Fixed positions of cubes in the scene
     glm::vec3 cubePositions[10];
 
-    Mesh mesh[10];
+    // shared primitives from GeometryFactory (equal shapes are one mesh)
+    std::shared_ptr<Mesh> mesh[10];
 
     // Animation control for cube rotations
     float rotationAngle;
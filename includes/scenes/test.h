@@ -4,6 +4,7 @@
 #include "core/LightManager.h"
 #include "core/rendering/Renderer.h"
 #include "core/Entity.h"
+#include "core/SceneBVH.h"
 
 
 class Test : public Scene
@@ -33,11 +34,15 @@ private:
     // The shader program for this scene
     std::shared_ptr<Shader> shader;
 
-    Mesh cube;
-    Mesh floor;
+    std::shared_ptr<Mesh> cube;
+    std::shared_ptr<Mesh> floor;
 
     Renderer renderer;
     LightManager lightManager;
 
     std::vector<Entity> entities;
+
+    // entity picking (left click toggles the outline of the entity under the crosshair)
+    SceneBVH sceneBvh;
+    void pick();
 };
\ No newline at end of file
@@ -16,6 +16,9 @@ struct Material {
     bool useSpecularMap;
 };
 
+// Lights live in the "Lights" uniform block (std140, binding 1) shared by all lit
+// shaders; members are ordered so every scalar fills the padding after a vec3.
+// Must match the GPU* structs in LightManager.h.
 struct DirLight {
     vec3 direction;
     vec3 ambient;
@@ -24,39 +27,76 @@ struct DirLight {
 };
 
 struct PointLight {
-    vec3 position;
-    vec3 ambient;
-    vec3 diffuse;
+    vec3 position;  float constant;
+    vec3 ambient;   float linear;
+    vec3 diffuse;   float quadratic;
     vec3 specular;
-    float constant;
-    float linear;
-    float quadratic;
 };
 
 struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float innerCutOff;
-    float outerCutOff;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float constant;
-    float linear;
-    float quadratic;
+    vec3 position;  float constant;
+    vec3 direction; float linear;
+    vec3 ambient;   float quadratic;
+    vec3 diffuse;   float innerCutOff;
+    vec3 specular;  float outerCutOff;
 };
 
 #define MAX_POINT_LIGHTS 8
 #define MAX_SPOT_LIGHTS 4
 
-uniform int numPointLights;
-uniform int numSpotLights;
+// Compile-time specialization (see Renderer::specialize). Variants define SPECIALIZED,
+// the exact light counts NUM_POINT / NUM_SPOT, and DIFFUSE_MAP / SPECULAR_MAP when the
+// material samples them, so loops unroll and material branches disappear.
+// Without SPECIALIZED the shader reads the counts and material flags at runtime.
+#ifdef SPECIALIZED
+#define POINT_COUNT NUM_POINT
+#define SPOT_COUNT NUM_SPOT
+#else
+#define POINT_COUNT numPointLights
+#define SPOT_COUNT numSpotLights
+#endif
+
+layout (std140) uniform Lights
+{
+    DirLight dirLight;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    SpotLight spotLights[MAX_SPOT_LIGHTS];
+    int numPointLights;
+    int numSpotLights;
+};
 
-uniform DirLight dirLight;
-uniform PointLight pointLights[MAX_POINT_LIGHTS];
-uniform SpotLight spotLights[MAX_SPOT_LIGHTS];
 uniform Material material;
-uniform vec3 viewPos;
+
+#ifdef MULTI_DRAW
+// Draws merged into one glMultiDrawElementsIndirect read their material values
+// from here (textures are still shared uniforms within a merged group)
+struct MaterialData {
+    vec4 diffuseColor;
+    vec4 specularColor; // w = shininess
+};
+
+layout (std430, binding = 0) readonly buffer Materials
+{
+    MaterialData materials[];
+};
+
+flat in uint MaterialIndex;
+
+#define DIFFUSE_COLOR  materials[MaterialIndex].diffuseColor.rgb
+#define SPECULAR_COLOR materials[MaterialIndex].specularColor.rgb
+#define SHININESS      materials[MaterialIndex].specularColor.w
+#else
+#define DIFFUSE_COLOR  material.diffuseColor
+#define SPECULAR_COLOR material.specularColor
+#define SHININESS      material.shininess
+#endif
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 // Function declarations
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
@@ -70,9 +110,9 @@ void main()
 
     // Combine lighting contributions
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    for (int i = 0; i < numPointLights; i++)
+    for (int i = 0; i < POINT_COUNT; i++)
         result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
-    for (int i = 0; i < numSpotLights; i++)
+    for (int i = 0; i < SPOT_COUNT; i++)
         result += CalcSpotLight(spotLights[i], norm, FragPos, viewDir);
 
     FragColor = vec4(result, 1.0);
@@ -81,18 +121,30 @@ void main()
 // Helper to get material colors
 vec3 GetDiffuseColor()
 {
+#if defined(DIFFUSE_MAP)
+    return texture(material.diffuse, TexCoords).rgb;
+#elif defined(SPECIALIZED)
+    return DIFFUSE_COLOR;
+#else
     if (material.useDiffuseMap)
         return texture(material.diffuse, TexCoords).rgb;
     else
-        return material.diffuseColor;
+        return DIFFUSE_COLOR;
+#endif
 }
 
 vec3 GetSpecularColor()
 {
+#if defined(SPECULAR_MAP)
+    return texture(material.specular, TexCoords).rgb;
+#elif defined(SPECIALIZED)
+    return SPECULAR_COLOR;
+#else
     if (material.useSpecularMap)
         return texture(material.specular, TexCoords).rgb;
     else
-        return material.specularColor;
+        return SPECULAR_COLOR;
+#endif
 }
 
 // ------------------- DIRECTIONAL LIGHT -------------------
@@ -101,7 +153,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 lightDir = normalize(-light.direction);
     float diff = max(dot(normal, lightDir), 0.0);
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), SHININESS);
 
     vec3 ambient  = light.ambient  * GetDiffuseColor();
     vec3 diffuse  = light.diffuse  * diff * GetDiffuseColor();
@@ -116,7 +168,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     vec3 lightDir = normalize(light.position - fragPos);
     float diff = max(dot(normal, lightDir), 0.0);
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), SHININESS);
 
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + 
@@ -139,7 +191,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     vec3 lightDir = normalize(light.position - fragPos);
     float diff = max(dot(normal, lightDir), 0.0);
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), SHININESS);
 
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance +
@@ -0,0 +1,35 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+// per-instance attributes (divisor 1), filled by the Renderer
+layout (location = 3) in mat4 aModel;        // locations 3..6
+layout (location = 7) in mat3 aNormalMatrix; // locations 7..9
+#ifdef MULTI_DRAW
+layout (location = 10) in uint aMaterial;    // into the Materials storage buffer
+flat out uint MaterialIndex;
+#endif
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+void main()
+{
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    Normal = aNormalMatrix * aNormal;
+    TexCoords = aTexCoords;
+#ifdef MULTI_DRAW
+    MaterialIndex = aMaterial;
+#endif
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -4,8 +4,14 @@ layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTex; // optional if you keep same VAO layout
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix; // inverse-transpose of model, computed on the CPU
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 uniform float outlinePixels;   // desired thickness in pixels (e.g. 3.0)
 uniform float screenHeight;    // viewport height in pixels
@@ -15,14 +21,13 @@ uniform float fovDegrees;      // vertical fov in degrees
 void main()
 {
     // Transform position & normal into view space
-    vec4 viewPos = view * model * vec4(aPos, 1.0);
+    vec4 viewSpacePos = view * model * vec4(aPos, 1.0);
 
-    // Normal transform (use upper-left 3x3 of view*model)
-    mat3 normalMatrix = transpose(inverse(mat3(view * model)));
-    vec3 viewNormal = normalize(normalMatrix * aNormal);
+    // Normal transform: the view matrix is rigid, so its 3x3 carries normals as-is
+    vec3 viewNormal = normalize(mat3(view) * normalMatrix * aNormal);
 
     // positive depth
-    float depth = -viewPos.z; // view space z is negative in right-handed camera
+    float depth = -viewSpacePos.z; // view space z is negative in right-handed camera
 
     // compute view-space offset that corresponds to outlinePixels
     float fovRad = radians(fovDegrees);
@@ -30,7 +35,7 @@ void main()
     float offsetView = outlinePixels * (viewHeight / screenHeight);
 
     // move along the view-space normal
-    vec3 offsetPosView = viewPos.xyz + viewNormal * offsetView;
+    vec3 offsetPosView = viewSpacePos.xyz + viewNormal * offsetView;
 
     // project to clip space
     vec4 clip = projection * vec4(offsetPosView, 1.0);
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+// per-instance model matrix (divisor 1), filled by the Renderer
+layout (location = 3) in mat4 aModel;
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+void main()
+{
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+}
@@ -1,10 +1,16 @@
 #include "helpers/shaderClass.h"
+#include "core/rendering/GLState.h"
+#include "core/rendering/UniformBuffer.h"
+#include "core/rendering/ProgramCache.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+Shader::Shader(const char* vertexPath, const char* fragmentPath,
+    const std::vector<std::string>& defines)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines)
+{
     std::string vertexCode, fragmentCode;
     try {
         std::ifstream vFile(vertexPath);
@@ -22,44 +28,82 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
         std::cerr << "ERROR::SHADER::FILE_NOT_READ\n" << e.what() << std::endl;
     }
 
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
+    if (!defines.empty()) {
+        vertexCode = injectDefines(vertexCode, defines);
+        fragmentCode = injectDefines(fragmentCode, defines);
+    }
+
+    // a binary from an earlier run skips compiling and linking (see ProgramCache)
+    const bool cached = ProgramCache::Enabled();
+    const uint64_t key = cached ? ProgramCache::MakeKey(vertexCode, fragmentCode) : 0;
+    ID = cached ? ProgramCache::Load(key) : 0;
+    if (!ID)
+        ID = buildProgram(vertexCode.c_str(), fragmentCode.c_str(), cached ? &key : nullptr);
 
+    // engine-wide uniform blocks live at fixed binding points (GLSL 330 has no layout(binding));
+    // set on restored programs too, as a binary need not carry them
+    bindUniformBlock("Camera", UniformBinding::Camera);
+    bindUniformBlock("Lights", UniformBinding::Lights);
+}
+
+unsigned int Shader::buildProgram(const char* vShaderCode, const char* fShaderCode, const uint64_t* cacheKey) const
+{
     unsigned int vertex = compileShader(GL_VERTEX_SHADER, vShaderCode);
     unsigned int fragment = compileShader(GL_FRAGMENT_SHADER, fShaderCode);
 
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    if (cacheKey) ProgramCache::PrepareForSave(program);
+    glLinkProgram(program);
+    checkCompileErrors(program, "PROGRAM");
+
+    int linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked && cacheKey)
+        ProgramCache::Save(*cacheKey, program);
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    return program;
 }
 
 Shader::~Shader() {
-    if (ID) glDeleteProgram(ID);
+    if (ID) {
+        GLState::ForgetProgram(ID);
+        glDeleteProgram(ID);
+    }
 }
 
-Shader::Shader(Shader&& other) noexcept : ID(other.ID) {
+Shader::Shader(Shader&& other) noexcept
+    : ID(other.ID), vertexPath(std::move(other.vertexPath)), fragmentPath(std::move(other.fragmentPath)),
+    defines(std::move(other.defines)), uniformCache(std::move(other.uniformCache))
+{
     other.ID = 0;
 }
 
 Shader& Shader::operator=(Shader&& other) noexcept {
     if (this != &other) {
-        if (ID) glDeleteProgram(ID);
+        if (ID) {
+            GLState::ForgetProgram(ID);
+            glDeleteProgram(ID);
+        }
         ID = other.ID;
+        vertexPath = std::move(other.vertexPath);
+        fragmentPath = std::move(other.fragmentPath);
+        defines = std::move(other.defines);
+        uniformCache = std::move(other.uniformCache);
         other.ID = 0;
     }
     return *this;
 }
 
-void Shader::use() const { glUseProgram(ID); }
+void Shader::use() const { GLState::UseProgram(ID); }
 
 void Shader::setBool(const std::string& name, bool value) const { glUniform1i(getUniformLocation(name), (int)value); }
 void Shader::setInt(const std::string& name, int value) const { glUniform1i(getUniformLocation(name), value); }
 void Shader::setFloat(const std::string& name, float value) const { glUniform1f(getUniformLocation(name), value); }
+void Shader::setMat3(const std::string& name, const glm::mat3& value) const { glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value)); }
 void Shader::setMat4(const std::string& name, const glm::mat4& value) const { glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value)); }
 void Shader::setVec3(const std::string& name, const glm::vec3& value) const { glUniform3fv(getUniformLocation(name), 1, glm::value_ptr(value)); }
 void Shader::setVec3(const std::string& name, float x, float y, float z) const { setVec3(name, glm::vec3(x, y, z)); }
@@ -72,6 +116,41 @@ int Shader::getUniformLocation(const std::string& name) const {
     return location;
 }
 
+void Shader::bindUniformBlock(const char* blockName, unsigned int binding) const {
+    unsigned int index = glGetUniformBlockIndex(ID, blockName);
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding(ID, index, binding);
+}
+
+bool Shader::HasDefine(const std::string& name) const {
+    for (const std::string& d : defines)
+        if (d.compare(0, d.find('='), name) == 0) return true;
+    return false;
+}
+
+// #defines must follow #version, so insert them after the line that holds it.
+// GLSL_VERSION=<n> is not emitted as a define: it replaces the #version line itself.
+std::string Shader::injectDefines(const std::string& code, const std::vector<std::string>& defines) {
+    std::string block, versionLine;
+    for (const std::string& d : defines) {
+        size_t eq = d.find('=');
+        std::string name = d.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : d.substr(eq + 1);
+        if (name == "GLSL_VERSION") {
+            versionLine = "#version " + value + " core\n";
+            continue;
+        }
+        block += "#define " + name + (value.empty() ? "" : " " + value) + "\n";
+    }
+
+    size_t version = code.find("#version");
+    if (version == std::string::npos) return versionLine + block + code;
+
+    size_t lineEnd = code.find('\n', version);
+    lineEnd = lineEnd == std::string::npos ? code.size() : lineEnd + 1;
+    std::string head = versionLine.empty() ? code.substr(0, lineEnd) : code.substr(0, version) + versionLine;
+    return head + block + code.substr(lineEnd);
+}
+
 unsigned int Shader::compileShader(unsigned int type, const char* code) const {
     unsigned int shader = glCreateShader(type);
     glShaderSource(shader, 1, &code, nullptr);
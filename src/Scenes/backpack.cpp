@@ -11,7 +11,7 @@
 Backpack::Backpack(Window& win)
     : shader(nullptr),
     rotationAngle(0.0f), rotationSpeed(50.0f),
-    win(win), obj("resources/models/backpack/backpack.obj")
+    win(win), obj("resources/models/backpack/backpack.obj", VertexFormat::Packed, LoadMode::Async)
 {
   
 }
@@ -22,7 +22,7 @@ Backpack::~Backpack()
 
 void Backpack::init()
 {
-    std::cerr << "Backpack model mesh count: " << obj.GetMeshCount() << "\n";
+    // obj is still loading; its meshes appear as Model::UploadPending() uploads them
 
     // shaders
     shader = ResourceManager::LoadShader("factory",
@@ -109,15 +109,14 @@ void Backpack::render()
     glm::mat4 proj = glm::perspective(glm::radians(app->camera.Zoom),
         (float)win.Width() / (float)win.Height(), 0.1f, 100.0f);
 
-    renderer.BeginScene(view, proj, app->camera.Position);
+    renderer.BeginScene(view, proj, app->camera.Position, (float)win.Height());
+    renderer.SetLights(lightManager);
 
     if (!lightManager.spots.empty()) {
         lightManager.spots[0].position = win.GetAppState()->camera.Position;
         lightManager.spots[0].direction = win.GetAppState()->camera.Front;
     }
 
-    if (shader) lightManager.ApplyToShader(*shader);
-
     // Draw entities
     for (auto& e : entities) {
         e.Render(renderer);
@@ -38,10 +38,11 @@ void FactoryScene::init()
         "shaders/modularVertexShader.vs",
         "shaders/modularFragmentShader.fs");
 
-    diffuseMap = ResourceManager::LoadTexture(
-        "resources/textures/metalDiff.png", TextureType::TEX_DIFFUSE);
-    specularMap = ResourceManager::LoadTexture(
-        "resources/textures/metalSpec.png", TextureType::TEX_SPECULAR);
+    std::vector<std::shared_ptr<Texture>> maps = ResourceManager::LoadTextures({
+        { "resources/textures/metalDiff.png", TextureType::TEX_DIFFUSE },
+        { "resources/textures/metalSpec.png", TextureType::TEX_SPECULAR } });
+    diffuseMap = maps[0];
+    specularMap = maps[1];
 
     // --- create meshes first and give each its own Material ---
     for (int i = 0; i < 10; ++i)
@@ -81,7 +82,7 @@ void FactoryScene::init()
         if (randomInt == 2) { mat->shininess = 24.0f; mat->specularColor = glm::vec3(0.6f); } // torus - slightly rougher
         Entity e;
         e.type = Entity::Type::Mesh;
-        e.meshRenderer.mesh = &mesh[i];
+        e.meshRenderer.mesh = mesh[i].get();
         e.meshRenderer.material = mat;
         e.meshRenderer.shader = shader;
         e.transform.position = cubePositions[i];
@@ -161,15 +162,14 @@ void FactoryScene::render()
     glm::mat4 proj = glm::perspective(glm::radians(app->camera.Zoom),
         (float)win.Width() / (float)win.Height(), 0.1f, 100.0f);
 
-    renderer.BeginScene(view, proj, app->camera.Position);
+    renderer.BeginScene(view, proj, app->camera.Position, (float)win.Height());
+    renderer.SetLights(lightManager);
 
     if (!lightManager.spots.empty()) {
         lightManager.spots[0].position = win.GetAppState()->camera.Position;
         lightManager.spots[0].direction = win.GetAppState()->camera.Front;
     }
 
-    if (shader) lightManager.ApplyToShader(*shader);
-
     // Draw entities
     for (auto& e : entities) {
         e.Render(renderer);
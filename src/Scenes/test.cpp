@@ -1,5 +1,6 @@
 ﻿#include "scenes/test.h"
 #include "core/ResourceManager.h"
+#include "core/InputManager.h"
 #include "core/rendering/geometry/GeometryFactory.h"
 
 Test::Test(Window& win) : win(win), shader(nullptr)
@@ -12,11 +13,16 @@ void Test::init()
         "shaders/modularVertexShader.vs",
         "shaders/modularFragmentShader.fs");
 
-    floorDiffuseMap = ResourceManager::LoadTexture("resources/textures/woodDiff.png", TextureType::TEX_DIFFUSE);
-    floorSpecularMap = ResourceManager::LoadTexture("resources/textures/woodSpec.png", TextureType::TEX_SPECULAR);
-
-    cubeDiffuseMap = ResourceManager::LoadTexture("resources/textures/crateDiff.jpg", TextureType::TEX_DIFFUSE);
-    cubeSpecularMap = ResourceManager::LoadTexture("resources/textures/crateSpec.jpg", TextureType::TEX_SPECULAR);
+    // decoded in parallel
+    std::vector<std::shared_ptr<Texture>> maps = ResourceManager::LoadTextures({
+        { "resources/textures/woodDiff.png", TextureType::TEX_DIFFUSE },
+        { "resources/textures/woodSpec.png", TextureType::TEX_SPECULAR },
+        { "resources/textures/crateDiff.jpg", TextureType::TEX_DIFFUSE },
+        { "resources/textures/crateSpec.jpg", TextureType::TEX_SPECULAR } });
+    floorDiffuseMap = maps[0];
+    floorSpecularMap = maps[1];
+    cubeDiffuseMap = maps[2];
+    cubeSpecularMap = maps[3];
 
     // create procedural geometry
     cube = GeometryFactory::CreateCube();
@@ -67,7 +73,7 @@ void Test::init()
             {
                 Entity cubeEntity;
                 cubeEntity.type = Entity::Type::Mesh;
-                cubeEntity.meshRenderer.mesh = &cube;
+                cubeEntity.meshRenderer.mesh = cube.get();
                 cubeEntity.meshRenderer.material = std::make_shared<Material>(cubeMat);
                 cubeEntity.meshRenderer.shader = shader;
 
@@ -87,7 +93,7 @@ void Test::init()
 
     Entity eFloor;
     eFloor.type = Entity::Type::Mesh;
-    eFloor.meshRenderer.mesh = &floor;       // plane has its own material
+    eFloor.meshRenderer.mesh = floor.get();       // plane has its own material
     eFloor.meshRenderer.material = std::make_shared<Material>(floorMat);
     eFloor.meshRenderer.shader = shader;
     eFloor.transform.position = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -129,6 +135,31 @@ void Test::init()
     rim.specular = glm::vec3(0.4f);
     rim.constant = 1.0f; rim.linear = 0.09f; rim.quadratic = 0.032f;
     lightManager.AddPointLight(rim);
+
+    // --- picking: the entities never move, so the BVH is built once ---
+    sceneBvh.Build(entities);
+    if (InputManager* input = win.GetInputManager()) {
+        input->BindMouseButton(GLFW_MOUSE_BUTTON_LEFT, GLFW_PRESS, [this]() {
+            AppState* app = win.GetAppState();
+            if (app && !app->scenes.empty() && app->scenes[app->currentSceneIndex] == this)
+                pick();
+        });
+    }
+}
+
+void Test::pick()
+{
+    const Camera& camera = win.GetAppState()->camera;
+    Ray ray;
+    ray.origin = camera.Position;
+    ray.direction = camera.Front;
+
+    RayHit hit;
+    if (!sceneBvh.Raycast(ray, hit)) return;
+
+    Material* material = entities[hit.entity].meshRenderer.material.get();
+    if (material)
+        material->outlineEnabled = !material->outlineEnabled;
 }
 
 void Test::update()
@@ -144,15 +175,14 @@ void Test::render()
     glm::mat4 proj = glm::perspective(glm::radians(app->camera.Zoom),
         (float)win.Width() / (float)win.Height(), 0.1f, 100.0f);
 
-    renderer.BeginScene(view, proj, app->camera.Position);
+    renderer.BeginScene(view, proj, app->camera.Position, (float)win.Height());
+    renderer.SetLights(lightManager);
 
     if (!lightManager.spots.empty()) {
         lightManager.spots[0].position = win.GetAppState()->camera.Position;
         lightManager.spots[0].direction = win.GetAppState()->camera.Front;
     }
 
-    if (shader) lightManager.ApplyToShader(*shader);
-
     // Draw entities
     for (auto& e : entities) {
         e.Render(renderer);
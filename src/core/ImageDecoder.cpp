@@ -0,0 +1,155 @@
+#include "core/ImageDecoder.h"
+#include <algorithm>
+#include <iostream>
+#include <stb_image.h>
+#include "core/rendering/GLCaps.h"
+#include "core/rendering/TextureCache.h"
+#include "core/rendering/TextureCompressor.h"
+
+std::vector<std::thread> ImageDecoder::workers;
+std::mutex ImageDecoder::mutex;
+std::condition_variable ImageDecoder::wake;
+std::condition_variable ImageDecoder::finished;
+std::deque<std::shared_ptr<ImageDecoder::Job>> ImageDecoder::queue;
+std::unordered_map<std::string, std::weak_ptr<ImageDecoder::Job>> ImageDecoder::jobs;
+bool ImageDecoder::stopping = false;
+
+void ImageData::Free::operator()(unsigned char* pixels) const
+{
+    stbi_image_free(pixels);
+}
+
+void ImageDecoder::Init(unsigned threads)
+{
+    if (!workers.empty()) return;
+
+    if (threads == 0)
+    {
+        unsigned hardware = std::thread::hardware_concurrency();
+        threads = std::min(hardware > 1 ? hardware - 1 : 1u, DEFAULT_THREADS);
+    }
+
+    stopping = false;
+    for (unsigned i = 0; i < threads; ++i)
+        workers.emplace_back(workerMain);
+#ifdef PYRE_VERBOSE
+    std::cout << "ImageDecoder: " << threads << " decode threads\n";
+#endif
+}
+
+void ImageDecoder::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers)
+        t.join();
+    workers.clear();
+
+    // nothing will run what is left: fail it, so no one waits forever
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::shared_ptr<Job>& job : queue)
+        job->state.store(Job::DONE, std::memory_order_release);
+    queue.clear();
+    jobs.clear();
+    finished.notify_all();
+}
+
+ImageData ImageDecoder::DecodeNow(const std::string& path)
+{
+    // per-thread flag: decode threads must not race on stb's global one
+    stbi_set_flip_vertically_on_load_thread(true);
+
+    ImageData image;
+    image.pixels.reset(stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0));
+    if (!image)
+        std::cerr << "ImageDecoder: Failed to load texture " << path << "\n";
+    return image;
+}
+
+std::shared_ptr<const ImageDecoder::Job> ImageDecoder::Decode(const std::string& path)
+{
+    std::shared_ptr<Job> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = jobs.find(path);
+        if (it != jobs.end() && (job = it->second.lock())) return job;
+
+        // drop decodes no one holds any more (this path's included) before adding one
+        std::erase_if(jobs, [](const auto& entry) { return entry.second.expired(); });
+        job = std::make_shared<Job>();
+        job->path = path;
+        jobs.emplace(path, job);
+        if (!workers.empty())
+        {
+            queue.push_back(job);
+            wake.notify_one();
+            return job;
+        }
+        job->state = Job::RUNNING;
+    }
+
+    run(*job);
+    return job;
+}
+
+void ImageDecoder::Wait(const Job& job)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (job.state.load() == Job::QUEUED)
+    {
+        // take it out of the queue rather than wait for a worker to get to it
+        auto it = std::find_if(queue.begin(), queue.end(),
+            [&](const std::shared_ptr<Job>& queued) { return queued.get() == &job; });
+        if (it != queue.end())
+        {
+            std::shared_ptr<Job> stolen = *it;
+            queue.erase(it);
+            stolen->state = Job::RUNNING;
+            lock.unlock();
+            run(*stolen);
+            return;
+        }
+    }
+    finished.wait(lock, [&] { return job.Ready(); });
+}
+
+void ImageDecoder::run(Job& job)
+{
+    // cooked files load as they are; a source without one is cooked once, here
+    const bool compress = GLCaps::TextureCompression();
+    if (!compress || !TextureCache::Load(job.path, job.compressed))
+    {
+        job.image = DecodeNow(job.path);
+        if (compress && job.image)
+        {
+            job.compressed = TextureCompressor::Compress(job.image);
+            TextureCache::Save(job.path, job.compressed);
+            job.image = {};
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job.state.store(Job::DONE, std::memory_order_release);
+    }
+    finished.notify_all();
+}
+
+void ImageDecoder::workerMain()
+{
+    for (;;)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [] { return stopping || !queue.empty(); });
+            if (stopping) return;
+            job = std::move(queue.front());
+            queue.pop_front();
+            job->state = Job::RUNNING;
+        }
+        run(*job);
+    }
+}
@@ -26,6 +26,10 @@ void InputManager::BindScroll(std::function<void(double)> callback) {
 	scrollCallbacks.push_back(std::move(callback));
 }
 
+void InputManager::BindMouseButton(int button, int action, std::function<void()> callback) {
+	mouseButtonBindings[button].push_back({ action, std::move(callback) });
+}
+
 void InputManager::HandleKey(int key, int action, int mods) {
     if (!mouseCaptured) return;
     // maintain pressed state for continuous handling
@@ -68,11 +72,21 @@ void InputManager::HandleScroll(double xoffset, double yoffset) {
 
 void InputManager::HandleMouseButton(int button, int action, int mods) {
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && !mouseCaptured) {
-        ToggleMouseCapture(true); // recapture
+        ToggleMouseCapture(true); // recapture (the click itself is not passed on)
+        return;
     }
 
     if (!mouseCaptured)
         return;
+
+    auto it = mouseButtonBindings.find(button);
+    if (it != mouseButtonBindings.end()) {
+        for (auto& bind : it->second) {
+            if (bind.action == action) {
+                bind.func();
+            }
+        }
+    }
 }
 
 void InputManager::ToggleMouseCapture(bool forceEnable) {
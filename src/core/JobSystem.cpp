@@ -0,0 +1,121 @@
+#include "core/JobSystem.h"
+#include <algorithm>
+#include <iostream>
+
+std::vector<std::thread> JobSystem::workers;
+std::mutex JobSystem::mutex;
+std::condition_variable JobSystem::wake;
+std::condition_variable JobSystem::finished;
+JobSystem::Loop* JobSystem::current = nullptr;
+uint64_t JobSystem::generation = 0;
+unsigned JobSystem::active = 0;
+bool JobSystem::stopping = false;
+std::thread::id JobSystem::owner;
+
+void JobSystem::Init(unsigned threads)
+{
+    if (!workers.empty()) return;
+
+    if (threads == 0)
+    {
+        unsigned hardware = std::thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 0;
+    }
+
+    stopping = false;
+    owner = std::this_thread::get_id();
+    for (unsigned i = 0; i < threads; ++i)
+        workers.emplace_back(workerMain);
+#ifdef PYRE_VERBOSE
+    std::cout << "JobSystem: " << threads << " worker threads\n";
+#endif
+}
+
+void JobSystem::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers)
+        t.join();
+    workers.clear();
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t grain,
+    const std::function<void(uint32_t, uint32_t)>& fn)
+{
+    if (count == 0) return;
+    grain = std::max(grain, 1u);
+    if (workers.empty() || count <= grain || std::this_thread::get_id() != owner)
+    {
+        fn(0, count);
+        return;
+    }
+
+    Loop loop;
+    loop.fn = &fn;
+    loop.count = count;
+    loop.grain = grain;
+    loop.chunks = (count + grain - 1) / grain;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = &loop;
+        ++generation;
+    }
+    wake.notify_all();
+
+    runChunks(loop);
+
+    // the loop lives on this stack: wait until no worker can still touch it
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return loop.done.load() == loop.chunks; });
+    current = nullptr;
+    finished.wait(lock, [] { return active == 0; });
+}
+
+void JobSystem::runChunks(Loop& loop)
+{
+    for (;;)
+    {
+        uint32_t chunk = loop.next.fetch_add(1);
+        if (chunk >= loop.chunks) return;
+
+        uint32_t begin = chunk * loop.grain;
+        uint32_t end = std::min(begin + loop.grain, loop.count);
+        (*loop.fn)(begin, end);
+
+        if (loop.done.fetch_add(1) + 1 == loop.chunks)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.notify_all();
+        }
+    }
+}
+
+void JobSystem::workerMain()
+{
+    uint64_t seen = 0;
+    for (;;)
+    {
+        Loop* loop;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            loop = current;
+            if (!loop) continue;
+            ++active;
+        }
+
+        runChunks(*loop);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --active;
+        }
+        finished.notify_all();
+    }
+}
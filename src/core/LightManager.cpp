@@ -1,5 +1,12 @@
 #include "core/LightManager.h"
-#include <sstream>
+#include "core/rendering/UniformBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+LightManager::~LightManager()
+{
+    if (ubo) glDeleteBuffers(1, &ubo);
+}
 
 void LightManager::SetDirectional(const glm::vec3& d,
     const glm::vec3& ambient,
@@ -27,47 +34,88 @@ void LightManager::ClearSpotLights()
     spots.clear();
 }
 
-static constexpr int GLSL_MAX_POINT_LIGHTS = 8; // must match shader (#define MAX_POINT_LIGHTS 8)
-static constexpr int GLSL_MAX_SPOT_LIGHTS = 4; // must match shader (#define MAX_SPOT_LIGHTS 4)
+int LightManager::PointLightCount() const
+{
+    return static_cast<int>(std::min(points.size(), (size_t)MAX_POINT_LIGHTS));
+}
 
-void LightManager::ApplyToShader(Shader& shader) {
-    shader.use();
+int LightManager::SpotLightCount() const
+{
+    return static_cast<int>(std::min(spots.size(), (size_t)MAX_SPOT_LIGHTS));
+}
 
-    shader.setVec3("dirLight.direction", dir);
-    shader.setVec3("dirLight.ambient", dirAmbient);
-    shader.setVec3("dirLight.diffuse", dirDiffuse);
-    shader.setVec3("dirLight.specular", dirSpec);
+void LightManager::pack(LightBlock& block) const
+{
+    block.dirLight.direction = dir;
+    block.dirLight.ambient = dirAmbient;
+    block.dirLight.diffuse = dirDiffuse;
+    block.dirLight.specular = dirSpec;
 
-    // clamp sizes to shader capacity
-    int pointCount = static_cast<int>(std::min(points.size(), (size_t)GLSL_MAX_POINT_LIGHTS));
-    int spotCount = static_cast<int>(std::min(spots.size(), (size_t)GLSL_MAX_SPOT_LIGHTS));
+    block.numPointLights = PointLightCount();
+    block.numSpotLights = SpotLightCount();
 
-    shader.setInt("numPointLights", pointCount);
-    for (int i = 0; i < pointCount; ++i) {
+    for (int i = 0; i < block.numPointLights; ++i) {
         const auto& p = points[i];
-        std::string base = "pointLights[" + std::to_string(i) + "].";
-        shader.setVec3((base + "position").c_str(), p.position);
-        shader.setVec3((base + "ambient").c_str(), p.ambient);
-        shader.setVec3((base + "diffuse").c_str(), p.diffuse);
-        shader.setVec3((base + "specular").c_str(), p.specular);
-        shader.setFloat((base + "constant").c_str(), p.constant);
-        shader.setFloat((base + "linear").c_str(), p.linear);
-        shader.setFloat((base + "quadratic").c_str(), p.quadratic);
+        GPUPointLight& g = block.pointLights[i];
+        g.position = p.position;
+        g.ambient = p.ambient;
+        g.diffuse = p.diffuse;
+        g.specular = p.specular;
+        g.constant = p.constant;
+        g.linear = p.linear;
+        g.quadratic = p.quadratic;
     }
 
-    shader.setInt("numSpotLights", spotCount);
-    for (int i = 0; i < spotCount; ++i) {
+    for (int i = 0; i < block.numSpotLights; ++i) {
         const auto& s = spots[i];
-        std::string base = "spotLights[" + std::to_string(i) + "]."; // IMPORTANT: "spotLights" not "pointLights"
-        shader.setVec3((base + "position").c_str(), s.position);
-        shader.setVec3((base + "direction").c_str(), s.direction);
-        shader.setFloat((base + "innerCutOff").c_str(), s.innerCutOff);
-        shader.setFloat((base + "outerCutOff").c_str(), s.outerCutOff);
-        shader.setVec3((base + "ambient").c_str(), s.ambient);
-        shader.setVec3((base + "diffuse").c_str(), s.diffuse);
-        shader.setVec3((base + "specular").c_str(), s.specular);
-        shader.setFloat((base + "constant").c_str(), s.constant);
-        shader.setFloat((base + "linear").c_str(), s.linear);
-        shader.setFloat((base + "quadratic").c_str(), s.quadratic);
+        GPUSpotLight& g = block.spotLights[i];
+        g.position = s.position;
+        g.direction = s.direction;
+        g.innerCutOff = s.innerCutOff;
+        g.outerCutOff = s.outerCutOff;
+        g.ambient = s.ambient;
+        g.diffuse = s.diffuse;
+        g.specular = s.specular;
+        g.constant = s.constant;
+        g.linear = s.linear;
+        g.quadratic = s.quadratic;
+    }
+}
+
+void LightManager::Upload()
+{
+    pack(staging);
+
+    if (!ubo) {
+        // first upload sends the whole block
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), &staging, GL_DYNAMIC_DRAW);
+        uploaded = staging;
+        glBindBufferBase(GL_UNIFORM_BUFFER, UniformBinding::Lights, ubo);
+        return;
     }
-}
\ No newline at end of file
+
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+
+    // Re-send only the pieces whose packed bytes differ from what the GPU holds
+    // (typically just the camera-attached spot light)
+    auto sync = [&](void* dst, const void* src, size_t offset, size_t size) {
+        if (std::memcmp(dst, src, size) == 0) return;
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, src);
+        std::memcpy(dst, src, size);
+    };
+
+    sync(&uploaded.dirLight, &staging.dirLight, offsetof(LightBlock, dirLight), sizeof(GPUDirLight));
+    for (int i = 0; i < staging.numPointLights; ++i)
+        sync(&uploaded.pointLights[i], &staging.pointLights[i],
+            offsetof(LightBlock, pointLights) + i * sizeof(GPUPointLight), sizeof(GPUPointLight));
+    for (int i = 0; i < staging.numSpotLights; ++i)
+        sync(&uploaded.spotLights[i], &staging.spotLights[i],
+            offsetof(LightBlock, spotLights) + i * sizeof(GPUSpotLight), sizeof(GPUSpotLight));
+    sync(&uploaded.numPointLights, &staging.numPointLights,
+        offsetof(LightBlock, numPointLights), 2 * sizeof(int));
+
+    // every scene has its own manager, so (re)claim the shared binding point
+    glBindBufferBase(GL_UNIFORM_BUFFER, UniformBinding::Lights, ubo);
+}
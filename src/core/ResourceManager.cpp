@@ -1,17 +1,22 @@
 #include <iostream>
-#include <stb_image.h>
+#include <filesystem>
+#include <algorithm>
 #include "core/ResourceManager.h"
+#include "core/rendering/GLState.h"
+#include "core/rendering/TextureCache.h"
+#include "core/rendering/TextureUploader.h"
 
 std::map<std::string, std::shared_ptr<Shader>> ResourceManager::shaders;
 std::map<std::string, std::shared_ptr<Texture>> ResourceManager::textures;
 
 std::shared_ptr<Shader> ResourceManager::LoadShader(const std::string& name,
-    const std::string& vsPath, const std::string& fsPath)
+    const std::string& vsPath, const std::string& fsPath,
+    const std::vector<std::string>& defines)
 {
     auto it = shaders.find(name);
     if (it != shaders.end()) return it->second;
     try {
-        auto s = std::make_shared<Shader>(vsPath.c_str(), fsPath.c_str());
+        auto s = std::make_shared<Shader>(vsPath.c_str(), fsPath.c_str(), defines);
         shaders[name] = s;
         return s;
     }
@@ -28,36 +33,135 @@ std::shared_ptr<Shader> ResourceManager::GetShader(const std::string& name)
     return it->second;
 }
 
+std::string ResourceManager::variantKey(const std::string& vsPath, const std::string& fsPath,
+    std::vector<std::string> defines)
+{
+    std::sort(defines.begin(), defines.end());
+    std::string key = vsPath + "|" + fsPath;
+    for (const std::string& d : defines)
+        key += "|" + d;
+    return key;
+}
+
+std::shared_ptr<Shader> ResourceManager::LoadShaderVariant(const Shader& base,
+    const std::vector<std::string>& defines)
+{
+    return LoadShader(variantKey(base.GetVertexPath(), base.GetFragmentPath(), defines),
+        base.GetVertexPath(), base.GetFragmentPath(), defines);
+}
+
+std::shared_ptr<Shader> ResourceManager::LoadInstancedVariant(const Shader& base,
+    const std::vector<std::string>& extraDefines)
+{
+    std::filesystem::path vs(base.GetVertexPath());
+    std::filesystem::path instancedVs = vs.parent_path() /
+        (vs.stem().string() + "Instanced" + vs.extension().string());
+
+    std::vector<std::string> defines = base.GetDefines();
+    defines.insert(defines.end(), extraDefines.begin(), extraDefines.end());
+
+    std::string name = variantKey(instancedVs.generic_string(), base.GetFragmentPath(), defines);
+    auto it = shaders.find(name);
+    if (it != shaders.end()) return it->second;
+
+    // remember misses too, so the filesystem is only probed once per program
+    if (!std::filesystem::exists(instancedVs)) {
+        shaders[name] = nullptr;
+        return nullptr;
+    }
+    return LoadShader(name, instancedVs.generic_string(), base.GetFragmentPath(), defines);
+}
+
 std::shared_ptr<Texture> ResourceManager::LoadTexture(const std::string& path, TextureType type)
 {
-    if (textures.count(path)) return textures[path];
+    return LoadTextures({ { path, type } })[0];
+}
 
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
-    if (!data) {
-        std::cerr << "ResourceManager: Failed to load texture " << path << "\n";
-        return 0;
+std::vector<std::shared_ptr<Texture>> ResourceManager::LoadTextures(
+    const std::vector<std::pair<std::string, TextureType>>& requests)
+{
+    std::vector<std::shared_ptr<Texture>> result(requests.size());
+    std::vector<std::shared_ptr<const ImageDecoder::Job>> jobs(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        auto it = textures.find(requests[i].first);
+        if (it != textures.end())
+            result[i] = it->second;
+        else
+            jobs[i] = ImageDecoder::Decode(requests[i].first);
     }
 
-    GLenum format = (nrChannels == 1) ? GL_RED : (nrChannels == 3) ? GL_RGB : GL_RGBA;
+    // upload in whatever order the decodes finish
+    size_t remaining = std::count_if(jobs.begin(), jobs.end(),
+        [](const std::shared_ptr<const ImageDecoder::Job>& job) { return job != nullptr; });
+    while (remaining > 0)
+    {
+        size_t next = jobs.size();
+        for (size_t i = 0; i < jobs.size() && next == jobs.size(); ++i)
+            if (jobs[i] && jobs[i]->Ready()) next = i;
+        if (next == jobs.size())
+        {
+            // none finished yet: wait for (or decode) the first outstanding one
+            next = std::find_if(jobs.begin(), jobs.end(),
+                [](const std::shared_ptr<const ImageDecoder::Job>& job) { return job != nullptr; }) - jobs.begin();
+            ImageDecoder::Wait(*jobs[next]);
+        }
+
+        result[next] = CreateTexture(requests[next].first, requests[next].second, jobs[next]);
+        jobs[next].reset();
+        --remaining;
+    }
+    return result;
+}
 
+std::shared_ptr<Texture> ResourceManager::CreateTexture(const std::string& path, TextureType type,
+    const std::shared_ptr<const ImageDecoder::Job>& source)
+{
+    if (textures.count(path)) return textures[path];
+    const ImageData& image = source->Image();
+    const CompressedImage& compressed = source->Compressed();
+    if (!image && !compressed) return 0;
+
+    std::shared_ptr<Texture> texture = std::make_shared<Texture>();
+
+    // storage only; the pixels arrive through the uploader's staging ring
     unsigned int tex;
     glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    GLState::EditTexture(tex);
+    if (compressed)
+    {
+        // every level, as cooked (see TextureCache)
+        const GLenum internalFormat = TextureCache::InternalFormat(compressed.format);
+        for (size_t i = 0; i < compressed.levels.size(); ++i)
+        {
+            const CompressedImage::Level& level = compressed.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), internalFormat,
+                level.width, level.height, 0, static_cast<GLsizei>(level.size), nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(compressed.levels.size()) - 1);
+        texture->width = compressed.levels[0].width;
+        texture->height = compressed.levels[0].height;
+        texture->channels = compressed.channels;
+    }
+    else
+    {
+        GLenum format = TextureUploader::PixelFormat(image.channels);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE,
+            nullptr);
+        texture->width = image.width;
+        texture->height = image.height;
+        texture->channels = image.channels;
+    }
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    stbi_image_free(data);
-
-    std::shared_ptr<Texture> texture = std::make_shared<Texture>();
     texture->ID = tex;
     texture->type = type;
+    texture->path = path;
+    TextureUploader::Queue(texture, source);
 
     textures[path] = texture;
     return texture;
@@ -72,6 +176,8 @@ std::shared_ptr<Texture> ResourceManager::GetTexture(const std::string& path)
 
 void ResourceManager::Clear() 
 {
+    // pending uploads hold textures too
+    TextureUploader::Clear();
     textures.clear();
     shaders.clear();
 }
\ No newline at end of file
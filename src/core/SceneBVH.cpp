@@ -0,0 +1,201 @@
+#include "core/SceneBVH.h"
+#include <algorithm>
+#include "core/Entity.h"
+
+namespace
+{
+    constexpr uint32_t SCENE_LEAF_SIZE = 2;
+    using BVH::STACK_SIZE;
+}
+
+void SceneBVH::Clear()
+{
+    nodes.clear();
+    instances.clear();
+}
+
+void SceneBVH::Build(const std::vector<Entity>& entities)
+{
+    Clear();
+
+    std::vector<Instance> unordered;
+    unordered.reserve(entities.size());
+    for (size_t i = 0; i < entities.size(); ++i)
+    {
+        const Entity& e = entities[i];
+        Instance instance;
+        instance.entity = static_cast<uint32_t>(i);
+
+        const Bounds* bounds = nullptr;
+        if (e.type == Entity::Type::Mesh && e.meshRenderer.mesh)
+        {
+            instance.mesh = e.meshRenderer.mesh;
+            bounds = &instance.mesh->bounds;
+        }
+        else if (e.type == Entity::Type::Model && e.modelRenderer.model)
+        {
+            instance.model = e.modelRenderer.model;
+            bounds = &instance.model->GetBounds();
+        }
+        if (!bounds || !bounds->valid) continue;
+
+        glm::mat4 model = e.transform.GetModelMatrix();
+        instance.inverseModel = glm::inverse(model);
+        bounds->Transform(model, instance.min, instance.max);
+        unordered.push_back(instance);
+    }
+
+    std::vector<glm::vec3> boxMin(unordered.size()), boxMax(unordered.size());
+    for (size_t i = 0; i < unordered.size(); ++i)
+    {
+        boxMin[i] = unordered[i].min;
+        boxMax[i] = unordered[i].max;
+    }
+
+    std::vector<uint32_t> order;
+    BVH::Build(boxMin.data(), boxMax.data(), static_cast<uint32_t>(unordered.size()), SCENE_LEAF_SIZE,
+        nodes, order);
+
+    instances.reserve(order.size());
+    for (uint32_t index : order)
+        instances.push_back(unordered[index]);
+}
+
+bool SceneBVH::intersect(const Instance& instance, const Ray& ray, RayHit& hit, bool any) const
+{
+    // the direction is not renormalized, so t means the same in both spaces
+    Ray local;
+    local.origin = glm::vec3(instance.inverseModel * glm::vec4(ray.origin, 1.0f));
+    local.direction = glm::vec3(instance.inverseModel * glm::vec4(ray.direction, 0.0f));
+    local.tMax = std::min(ray.tMax, hit.t);
+
+    auto testMesh = [&](const Mesh* mesh) {
+        if (!mesh) return false;
+        if (mesh->bvh)
+        {
+            if (any) return mesh->bvh->RaycastAny(local);
+            if (!mesh->bvh->Raycast(local, hit)) return false;
+        }
+        else
+        {
+            if (!mesh->bounds.valid) return false;
+            BVH::Node box{ mesh->bounds.min, 0, mesh->bounds.max, 1 };
+            float t = BVH::IntersectNode(box, local.origin, BVH::InverseDirection(local.direction), local.tMax);
+            if (t == FLT_MAX) return false;
+            if (any) return true;
+            hit.t = t;
+            hit.triangle = UINT32_MAX;
+            hit.barycentric = glm::vec2(0.0f);
+        }
+        local.tMax = hit.t;
+        hit.mesh = mesh;
+        hit.entity = instance.entity;
+        return true;
+    };
+
+    if (instance.mesh) return testMesh(instance.mesh);
+
+    bool found = false;
+    for (const MeshEntry& entry : instance.model->GetMeshes())
+    {
+        if (testMesh(entry.mesh.get()))
+        {
+            found = true;
+            if (any) break;
+        }
+    }
+    return found;
+}
+
+bool SceneBVH::Raycast(const Ray& ray, RayHit& hit) const
+{
+    if (nodes.empty()) return false;
+
+    const glm::vec3 invDirection = BVH::InverseDirection(ray.direction);
+    bool found = false;
+    uint32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BVH::Node& node = nodes[stack[--top]];
+        float limit = std::min(ray.tMax, hit.t);
+        if (BVH::IntersectNode(node, ray.origin, invDirection, limit) == FLT_MAX) continue;
+
+        if (node.IsLeaf())
+        {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+                found |= intersect(instances[i], ray, hit, false);
+            continue;
+        }
+
+        // push the farther child first so the nearer one is visited next
+        uint32_t nearChild = node.leftOrFirst, farChild = node.leftOrFirst + 1;
+        float tNear = BVH::IntersectNode(nodes[nearChild], ray.origin, invDirection, limit);
+        float tFar = BVH::IntersectNode(nodes[farChild], ray.origin, invDirection, limit);
+        if (tFar < tNear)
+        {
+            std::swap(nearChild, farChild);
+            std::swap(tNear, tFar);
+        }
+        if (tFar != FLT_MAX) stack[top++] = farChild;
+        if (tNear != FLT_MAX) stack[top++] = nearChild;
+    }
+    return found;
+}
+
+bool SceneBVH::RaycastAny(const Ray& ray) const
+{
+    if (nodes.empty()) return false;
+
+    const glm::vec3 invDirection = BVH::InverseDirection(ray.direction);
+    uint32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BVH::Node& node = nodes[stack[--top]];
+        if (BVH::IntersectNode(node, ray.origin, invDirection, ray.tMax) == FLT_MAX) continue;
+
+        if (node.IsLeaf())
+        {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+            {
+                RayHit hit;
+                if (intersect(instances[i], ray, hit, true)) return true;
+            }
+            continue;
+        }
+        stack[top++] = node.leftOrFirst + 1;
+        stack[top++] = node.leftOrFirst;
+    }
+    return false;
+}
+
+void SceneBVH::QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& entities) const
+{
+    if (nodes.empty()) return;
+
+    auto overlaps = [&](const glm::vec3& lo, const glm::vec3& hi) {
+        return glm::all(glm::lessThanEqual(lo, max)) && glm::all(glm::greaterThanEqual(hi, min));
+    };
+
+    uint32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BVH::Node& node = nodes[stack[--top]];
+        if (!overlaps(node.min, node.max)) continue;
+
+        if (node.IsLeaf())
+        {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+                if (overlaps(instances[i].min, instances[i].max))
+                    entities.push_back(instances[i].entity);
+            continue;
+        }
+        stack[top++] = node.leftOrFirst + 1;
+        stack[top++] = node.leftOrFirst;
+    }
+}
@@ -1,5 +1,7 @@
 #include "core/Window.h"
 #include "core/InputManager.h"
+#include "core/rendering/GLState.h"
+#include "core/rendering/GLCaps.h"
 #include <iostream>
 
 Window::Window(float width, float height, const std::string& name)
@@ -33,6 +35,8 @@ Window::Window(float width, float height, const std::string& name)
 		std::cerr << "Failed to initialize GLAD\n";
 		return;
 	}
+	// post-3.3 entry points (optional render paths)
+	GLCaps::Load((GLADloadproc)glfwGetProcAddress);
 
 	inputManager = new InputManager(this);
 
@@ -46,7 +50,7 @@ Window::Window(float width, float height, const std::string& name)
 	glfwSetInputMode(win, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 
-	glEnable(GL_DEPTH_TEST);
+	GLState::SetDepthTest(true);
 }
 
 Window::~Window()
@@ -0,0 +1,108 @@
+#include "core/rendering/Frustum.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PYRE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+void BoxList::Push(const glm::vec3& min, const glm::vec3& max)
+{
+    minX.push_back(min.x); minY.push_back(min.y); minZ.push_back(min.z);
+    maxX.push_back(max.x); maxY.push_back(max.y); maxZ.push_back(max.z);
+}
+
+void BoxList::Clear()
+{
+    minX.clear(); minY.clear(); minZ.clear();
+    maxX.clear(); maxY.clear(); maxZ.clear();
+}
+
+void Frustum::Extract(const glm::mat4& m)
+{
+    // glm is column-major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0; // left
+    planes[1] = row3 - row0; // right
+    planes[2] = row3 + row1; // bottom
+    planes[3] = row3 - row1; // top
+    planes[4] = row3 + row2; // near
+    planes[5] = row3 - row2; // far
+
+    // normalize so sphere tests get true distances
+    for (glm::vec4& p : planes)
+        p /= glm::length(glm::vec3(p));
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const
+{
+    for (const glm::vec4& p : planes)
+        if (glm::dot(glm::vec3(p), center) + p.w < -radius)
+            return false;
+    return true;
+}
+
+bool Frustum::IntersectsBox(const glm::vec3& min, const glm::vec3& max) const
+{
+    for (const glm::vec4& p : planes)
+    {
+        // corner furthest along the plane normal; if it is outside, the whole box is
+        glm::vec3 corner(p.x >= 0.0f ? max.x : min.x,
+            p.y >= 0.0f ? max.y : min.y,
+            p.z >= 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(p), corner) + p.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void Frustum::CullBoxes(const BoxList& boxes, std::vector<uint8_t>& visible) const
+{
+    const std::size_t count = boxes.Size();
+    visible.resize(count);
+
+    std::size_t i = 0;
+#ifdef PYRE_SSE2
+    // the furthest corner only depends on the plane's signs, so pick its arrays once
+    const float* xs[6];
+    const float* ys[6];
+    const float* zs[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        xs[p] = planes[p].x >= 0.0f ? boxes.maxX.data() : boxes.minX.data();
+        ys[p] = planes[p].y >= 0.0f ? boxes.maxY.data() : boxes.minY.data();
+        zs[p] = planes[p].z >= 0.0f ? boxes.maxZ.data() : boxes.minZ.data();
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 outside = zero;
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), _mm_loadu_ps(xs[p] + i)),
+                    _mm_mul_ps(_mm_set1_ps(planes[p].y), _mm_loadu_ps(ys[p] + i))),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), _mm_loadu_ps(zs[p] + i)),
+                    _mm_set1_ps(planes[p].w)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, zero));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        visible[i + 0] = !(mask & 1);
+        visible[i + 1] = !(mask & 2);
+        visible[i + 2] = !(mask & 4);
+        visible[i + 3] = !(mask & 8);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        visible[i] = IntersectsBox(
+            glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]),
+            glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]));
+    }
+}
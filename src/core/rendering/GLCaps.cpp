@@ -0,0 +1,65 @@
+#include "core/rendering/GLCaps.h"
+#include <iostream>
+#include <cstring>
+
+int GLCaps::major = 3;
+int GLCaps::minor = 3;
+PFN_glMultiDrawElementsIndirect GLCaps::multiDrawIndirect = nullptr;
+PFN_glBufferStorage GLCaps::bufferStorage = nullptr;
+PFN_glGetProgramBinary GLCaps::getProgramBinary = nullptr;
+PFN_glProgramBinary GLCaps::programBinary = nullptr;
+PFN_glProgramParameteri GLCaps::programParameteri = nullptr;
+bool GLCaps::textureCompression = false;
+
+void GLCaps::Load(GLADloadproc loader)
+{
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+    multiDrawIndirect = nullptr;
+    if (AtLeast(4, 3))
+        multiDrawIndirect = (PFN_glMultiDrawElementsIndirect)loader("glMultiDrawElementsIndirect");
+
+    if (!multiDrawIndirect)
+        std::cout << "GLCaps: multi-draw indirect unavailable, using the GL 3.3 path\n";
+
+    bufferStorage = nullptr;
+    if (AtLeast(4, 4))
+        bufferStorage = (PFN_glBufferStorage)loader("glBufferStorage");
+
+    if (!bufferStorage)
+        std::cout << "GLCaps: buffer storage unavailable, stream buffers orphan instead of mapping\n";
+
+    textureCompression = false;
+    bool getProgramBinaryExtension = false;
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; ++i)
+    {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (!name) continue;
+        textureCompression |= std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0;
+        getProgramBinaryExtension |= std::strcmp(name, "GL_ARB_get_program_binary") == 0;
+    }
+
+    getProgramBinary = nullptr;
+    programBinary = nullptr;
+    programParameteri = nullptr;
+    GLint binaryFormats = 0;
+    if (AtLeast(4, 1) || getProgramBinaryExtension)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    // a driver without formats takes no binaries back
+    if (binaryFormats > 0)
+    {
+        getProgramBinary = (PFN_glGetProgramBinary)loader("glGetProgramBinary");
+        programParameteri = (PFN_glProgramParameteri)loader("glProgramParameteri");
+        if (getProgramBinary && programParameteri)
+            programBinary = (PFN_glProgramBinary)loader("glProgramBinary");
+    }
+
+    if (!programBinary)
+        std::cout << "GLCaps: program binaries unavailable, shaders compile on every run\n";
+
+    if (!textureCompression)
+        std::cout << "GLCaps: S3TC unavailable, textures are uploaded uncompressed\n";
+}
@@ -0,0 +1,190 @@
+#include "core/rendering/GLState.h"
+
+GLuint GLState::program = GLState::UNKNOWN;
+GLuint GLState::vertexArray = GLState::UNKNOWN;
+GLuint GLState::activeUnit = GLState::UNKNOWN;
+GLuint GLState::textures[GLState::MAX_TEXTURE_UNITS];
+
+int GLState::depthTest = -1;
+int GLState::stencilTest = -1;
+int GLState::blend = -1;
+int GLState::depthWrite = -1;
+GLenum GLState::depthFunc = GLState::UNKNOWN;
+
+GLuint GLState::stencilWriteMask = GLState::UNKNOWN;
+GLenum GLState::stencilFunc = GLState::UNKNOWN;
+GLint GLState::stencilRef = 0;
+GLuint GLState::stencilFuncMask = 0;
+GLenum GLState::stencilOps[3] = { GLState::UNKNOWN, GLState::UNKNOWN, GLState::UNKNOWN };
+
+GLenum GLState::blendSrc = GLState::UNKNOWN;
+GLenum GLState::blendDst = GLState::UNKNOWN;
+
+GLState::Stats GLState::stats;
+
+// textures[] has no constant initializer for "unknown", fill it before main()
+static const bool texturesInitialized = []() { GLState::Invalidate(); return true; }();
+
+// --------------------------------------------
+// Bindings
+// --------------------------------------------
+void GLState::UseProgram(GLuint id)
+{
+    if (program == id) { ++stats.skipped; return; }
+    glUseProgram(id);
+    program = id;
+    ++stats.issued;
+}
+
+void GLState::BindVertexArray(GLuint vao)
+{
+    if (vertexArray == vao) { ++stats.skipped; return; }
+    glBindVertexArray(vao);
+    vertexArray = vao;
+    ++stats.issued;
+}
+
+void GLState::BindTexture(GLuint unit, GLuint texture)
+{
+    if (unit >= MAX_TEXTURE_UNITS)
+    {
+        // outside the tracked range: always forward
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        activeUnit = unit;
+        stats.issued += 2;
+        return;
+    }
+
+    if (textures[unit] == texture) { ++stats.skipped; return; }
+
+    if (activeUnit != unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+        ++stats.issued;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    textures[unit] = texture;
+    ++stats.issued;
+}
+
+void GLState::EditTexture(GLuint texture)
+{
+    BindTexture(0, texture);
+    // a skipped bind leaves whichever unit was last used active
+    if (activeUnit != 0)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        activeUnit = 0;
+        ++stats.issued;
+    }
+}
+
+// --------------------------------------------
+// Fixed-function state
+// --------------------------------------------
+bool GLState::setCap(int& cached, GLenum cap, bool enabled)
+{
+    int value = enabled ? 1 : 0;
+    if (cached == value) { ++stats.skipped; return false; }
+    if (enabled) glEnable(cap); else glDisable(cap);
+    cached = value;
+    ++stats.issued;
+    return true;
+}
+
+void GLState::SetDepthTest(bool enabled) { setCap(depthTest, GL_DEPTH_TEST, enabled); }
+void GLState::SetStencilTest(bool enabled) { setCap(stencilTest, GL_STENCIL_TEST, enabled); }
+void GLState::SetBlend(bool enabled) { setCap(blend, GL_BLEND, enabled); }
+
+void GLState::DepthMask(bool write)
+{
+    int value = write ? 1 : 0;
+    if (depthWrite == value) { ++stats.skipped; return; }
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+    depthWrite = value;
+    ++stats.issued;
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+    if (depthFunc == func) { ++stats.skipped; return; }
+    glDepthFunc(func);
+    depthFunc = func;
+    ++stats.issued;
+}
+
+void GLState::StencilMask(GLuint mask)
+{
+    if (stencilWriteMask == mask) { ++stats.skipped; return; }
+    glStencilMask(mask);
+    stencilWriteMask = mask;
+    ++stats.issued;
+}
+
+void GLState::StencilFunc(GLenum func, GLint ref, GLuint mask)
+{
+    if (stencilFunc == func && stencilRef == ref && stencilFuncMask == mask) { ++stats.skipped; return; }
+    glStencilFunc(func, ref, mask);
+    stencilFunc = func;
+    stencilRef = ref;
+    stencilFuncMask = mask;
+    ++stats.issued;
+}
+
+void GLState::StencilOp(GLenum sfail, GLenum dpfail, GLenum dppass)
+{
+    if (stencilOps[0] == sfail && stencilOps[1] == dpfail && stencilOps[2] == dppass) { ++stats.skipped; return; }
+    glStencilOp(sfail, dpfail, dppass);
+    stencilOps[0] = sfail;
+    stencilOps[1] = dpfail;
+    stencilOps[2] = dppass;
+    ++stats.issued;
+}
+
+void GLState::BlendFunc(GLenum src, GLenum dst)
+{
+    if (blendSrc == src && blendDst == dst) { ++stats.skipped; return; }
+    glBlendFunc(src, dst);
+    blendSrc = src;
+    blendDst = dst;
+    ++stats.issued;
+}
+
+// --------------------------------------------
+// Object deletion / invalidation
+// --------------------------------------------
+void GLState::ForgetProgram(GLuint id)
+{
+    // a deleted program stays current until replaced; treat it as unknown
+    if (program == id) program = UNKNOWN;
+}
+
+void GLState::ForgetVertexArray(GLuint vao)
+{
+    if (vertexArray == vao) vertexArray = 0; // GL reverts the binding to 0
+}
+
+void GLState::ForgetTexture(GLuint texture)
+{
+    for (GLuint& bound : textures)
+        if (bound == texture) bound = 0;
+}
+
+void GLState::Invalidate()
+{
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (GLuint& bound : textures) bound = UNKNOWN;
+
+    depthTest = stencilTest = blend = depthWrite = -1;
+    depthFunc = UNKNOWN;
+
+    stencilWriteMask = UNKNOWN;
+    stencilFunc = UNKNOWN;
+    stencilOps[0] = stencilOps[1] = stencilOps[2] = UNKNOWN;
+
+    blendSrc = blendDst = UNKNOWN;
+}
@@ -0,0 +1,448 @@
+#include "core/rendering/GeometryPool.h"
+#include "core/rendering/GLState.h"
+#include "core/rendering/Mesh.h"
+#include <algorithm>
+#include <cstddef>
+
+GeometryPool::Arena GeometryPool::arenas[static_cast<int>(VertexFormat::Count)];
+GeometryPool::StreamArena GeometryPool::streams[static_cast<int>(VertexFormat::Count)];
+std::vector<GeometryRange> GeometryPool::ranges;
+std::vector<uint32_t> GeometryPool::freeHandles;
+uint32_t GeometryPool::repackCount = 0;
+
+// first buffers hold 64K vertices (~2 MB standard) and 768 KB of indices; they double when full
+static constexpr uint32_t INITIAL_VERTICES = 64 * 1024;
+static constexpr uint32_t INITIAL_INDEX_WORDS = 192 * 1024;
+
+static constexpr GLsizeiptr INDEX_WORD = 4;
+
+// per-frame streams start at 256 KB of vertices and 128 KB of indices (x3 frames in flight)
+static constexpr size_t INITIAL_STREAM_VERTEX_BYTES = 256 * 1024;
+static constexpr size_t INITIAL_STREAM_INDEX_BYTES = 128 * 1024;
+
+static GLsizeiptr vertexStride(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::Standard: return sizeof(Vertex);
+    case VertexFormat::Packed: return sizeof(PackedVertex);
+    default: return 0;
+    }
+}
+
+// index buffer words covered by a range (16-bit ranges round up to a whole word)
+static uint32_t indexWords(uint32_t indexCount, uint32_t indexSize)
+{
+    return (indexCount * indexSize + INDEX_WORD - 1) / INDEX_WORD;
+}
+
+static uint32_t firstWord(const GeometryRange& range)
+{
+    return range.firstIndex * range.indexSize / INDEX_WORD;
+}
+
+// --------------------------------------------
+// FreeList
+// --------------------------------------------
+bool GeometryPool::FreeList::CanFit(uint32_t count) const
+{
+    for (const Block& b : blocks)
+        if (b.count >= count) return true;
+    return false;
+}
+
+uint32_t GeometryPool::FreeList::Allocate(uint32_t count)
+{
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        Block& b = blocks[i];
+        if (b.count < count) continue;
+
+        uint32_t offset = b.offset;
+        b.offset += count;
+        b.count -= count;
+        if (b.count == 0) blocks.erase(blocks.begin() + i);
+        used += count;
+        return offset;
+    }
+    return INVALID;
+}
+
+void GeometryPool::FreeList::Free(uint32_t offset, uint32_t count)
+{
+    if (count == 0) return;
+    used -= count;
+
+    auto next = std::lower_bound(blocks.begin(), blocks.end(), offset,
+        [](const Block& b, uint32_t o) { return b.offset < o; });
+
+    // merge with the block before and/or after, so free space never splinters
+    bool mergePrev = next != blocks.begin() && (next - 1)->offset + (next - 1)->count == offset;
+    bool mergeNext = next != blocks.end() && offset + count == next->offset;
+
+    if (mergePrev && mergeNext)
+    {
+        (next - 1)->count += count + next->count;
+        blocks.erase(next);
+    }
+    else if (mergePrev)
+        (next - 1)->count += count;
+    else if (mergeNext)
+    {
+        next->offset = offset;
+        next->count += count;
+    }
+    else
+        blocks.insert(next, { offset, count });
+}
+
+// all free space is one block at the end
+bool GeometryPool::FreeList::IsPacked() const
+{
+    return blocks.empty() || (blocks.size() == 1 && blocks[0].offset == used);
+}
+
+void GeometryPool::FreeList::Reset(uint32_t newCapacity, uint32_t newUsed)
+{
+    capacity = newCapacity;
+    used = newUsed;
+    blocks.clear();
+    if (newUsed < newCapacity)
+        blocks.push_back({ newUsed, newCapacity - newUsed });
+}
+
+// --------------------------------------------
+// Allocate / Free
+// --------------------------------------------
+uint32_t GeometryPool::Allocate(VertexFormat format, const void* vertices, uint32_t vertexCount,
+    const uint32_t* indices, uint32_t indexCount)
+{
+    if (!vertices || vertexCount == 0) return INVALID;
+    if (!indices) indexCount = 0;
+
+    // every index of a mesh with fewer than 65536 vertices fits in 16 bits
+    const uint8_t indexSize = vertexCount < 65536 ? 2 : 4;
+    const uint32_t words = indexWords(indexCount, indexSize);
+
+    Arena& arena = arenas[static_cast<int>(format)];
+    if (!arena.vao)
+        repack(format, INITIAL_VERTICES, INITIAL_INDEX_WORDS);
+
+    if (!arena.vertices.CanFit(vertexCount) || (words && !arena.indices.CanFit(words)))
+    {
+        // repacking leaves all free space in one block; grow only if that is still too small
+        uint32_t vertexCapacity = arena.vertices.capacity;
+        uint32_t indexCapacity = arena.indices.capacity;
+        while (vertexCapacity - arena.vertices.used < vertexCount) vertexCapacity *= 2;
+        while (indexCapacity - arena.indices.used < words) indexCapacity *= 2;
+        repack(format, vertexCapacity, indexCapacity);
+    }
+
+    GeometryRange range;
+    range.format = format;
+    range.vertexCount = vertexCount;
+    range.indexCount = indexCount;
+    range.indexSize = indexSize;
+    range.baseVertex = arena.vertices.Allocate(vertexCount);
+    if (indexCount) range.firstIndex = arena.indices.Allocate(words) * INDEX_WORD / indexSize;
+
+    // upload through the copy targets so no VAO's element binding is touched
+    const GLsizeiptr stride = vertexStride(format);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena.vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range.baseVertex * stride, vertexCount * stride, vertices);
+    if (indexCount)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arena.ebo);
+        if (indexSize == 2)
+        {
+            std::vector<uint16_t> narrow(indices, indices + indexCount);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, firstWord(range) * INDEX_WORD,
+                indexCount * sizeof(uint16_t), narrow.data());
+        }
+        else
+            glBufferSubData(GL_COPY_WRITE_BUFFER, firstWord(range) * INDEX_WORD,
+                indexCount * sizeof(uint32_t), indices);
+    }
+
+    uint32_t handle;
+    if (!freeHandles.empty())
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+        ranges[handle] = range;
+    }
+    else
+    {
+        handle = static_cast<uint32_t>(ranges.size());
+        ranges.push_back(range);
+    }
+    return handle;
+}
+
+void GeometryPool::Free(uint32_t handle)
+{
+    if (handle >= ranges.size()) return;
+
+    GeometryRange& range = ranges[handle];
+    if (range.streamed)
+    {
+        // nothing to give back: stream space is reclaimed frame by frame
+        range = GeometryRange();
+        freeHandles.push_back(handle);
+        return;
+    }
+    if (range.vertexCount == 0) return;
+
+    Arena& arena = arenas[static_cast<int>(range.format)];
+    arena.vertices.Free(range.baseVertex, range.vertexCount);
+    arena.indices.Free(firstWord(range), indexWords(range.indexCount, range.indexSize));
+
+    range = GeometryRange();
+    freeHandles.push_back(handle);
+}
+
+// --------------------------------------------
+// repack - Copies every live range of a format, packed, into fresh buffers
+// of the given capacity (also used to create the buffers the first time)
+// --------------------------------------------
+void GeometryPool::repack(VertexFormat format, uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    Arena& arena = arenas[static_cast<int>(format)];
+    const GLsizeiptr stride = vertexStride(format);
+
+    GLuint vbo, ebo;
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * stride, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * INDEX_WORD, nullptr, GL_STATIC_DRAW);
+
+    // indices are relative to baseVertex, so moving a range is a plain copy
+    uint32_t vertexEnd = 0;
+    uint32_t indexEnd = 0;
+    if (arena.vbo)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, arena.vbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        for (GeometryRange& r : ranges)
+        {
+            if (r.vertexCount == 0 || r.streamed || r.format != format) continue;
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                r.baseVertex * stride, vertexEnd * stride, r.vertexCount * stride);
+            r.baseVertex = vertexEnd;
+            vertexEnd += r.vertexCount;
+        }
+
+        glBindBuffer(GL_COPY_READ_BUFFER, arena.ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        for (GeometryRange& r : ranges)
+        {
+            if (r.indexCount == 0 || r.streamed || r.format != format) continue;
+            const uint32_t words = indexWords(r.indexCount, r.indexSize);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                firstWord(r) * INDEX_WORD, indexEnd * INDEX_WORD, words * INDEX_WORD);
+            r.firstIndex = indexEnd * INDEX_WORD / r.indexSize;
+            indexEnd += words;
+        }
+
+        glDeleteBuffers(1, &arena.vbo);
+        glDeleteBuffers(1, &arena.ebo);
+        ++repackCount;
+    }
+    else
+    {
+        glGenVertexArrays(1, &arena.vao);
+    }
+
+    arena.vbo = vbo;
+    arena.ebo = ebo;
+    arena.vertices.Reset(vertexCapacity, vertexEnd);
+    arena.indices.Reset(indexCapacity, indexEnd);
+
+    // point the (unchanged) VAO at the new storage
+    GLState::BindVertexArray(arena.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, arena.vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.ebo);
+    setupAttributes(format);
+}
+
+// --------------------------------------------
+// Streamed geometry
+// --------------------------------------------
+uint32_t GeometryPool::AllocateStream(VertexFormat format)
+{
+    StreamArena& stream = streams[static_cast<int>(format)];
+    if (!stream.vao)
+    {
+        glGenVertexArrays(1, &stream.vao);
+        stream.vertices = std::make_unique<StreamBuffer>(INITIAL_STREAM_VERTEX_BYTES);
+        stream.indices = std::make_unique<StreamBuffer>(INITIAL_STREAM_INDEX_BYTES);
+    }
+
+    GeometryRange range;
+    range.format = format;
+    range.streamed = true;
+
+    uint32_t handle;
+    if (!freeHandles.empty())
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+        ranges[handle] = range;
+    }
+    else
+    {
+        handle = static_cast<uint32_t>(ranges.size());
+        ranges.push_back(range);
+    }
+    return handle;
+}
+
+// First write of a frame: move both streams to their next region, and re-point
+// the VAO if either buffer was reallocated to grow
+void GeometryPool::beginStreamFrame(VertexFormat format)
+{
+    StreamArena& stream = streams[static_cast<int>(format)];
+    stream.vertices->BeginFrame();
+    stream.indices->BeginFrame();
+    stream.frameOpen = true;
+
+    if (stream.boundVertices != stream.vertices->Buffer() || stream.boundIndices != stream.indices->Buffer())
+    {
+        GLState::BindVertexArray(stream.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, stream.vertices->Buffer());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream.indices->Buffer());
+        setupAttributes(format);
+        stream.boundVertices = stream.vertices->Buffer();
+        stream.boundIndices = stream.indices->Buffer();
+    }
+}
+
+bool GeometryPool::WriteStream(uint32_t handle, const void* vertices, uint32_t vertexCount,
+    const uint32_t* indices, uint32_t indexCount)
+{
+    if (handle >= ranges.size() || !ranges[handle].streamed) return false;
+
+    GeometryRange& range = ranges[handle];
+    StreamArena& stream = streams[static_cast<int>(range.format)];
+    if (!stream.frameOpen) beginStreamFrame(range.format);
+
+    if (!indices) indexCount = 0;
+    range.vertexCount = 0;
+    range.indexCount = 0;
+    range.indexSize = 4;
+    if (!vertices || vertexCount == 0) return true;
+
+    // baseVertex and firstIndex are offsets in elements, so align to whole elements
+    const GLsizeiptr stride = vertexStride(range.format);
+    // both are attempted even if one fails, so each stream learns how much the next frame needs
+    size_t vertexOffset = stream.vertices->Write(vertices, vertexCount * stride, stride);
+    size_t indexOffset = 0;
+    if (indexCount)
+        indexOffset = stream.indices->Write(indices, indexCount * sizeof(uint32_t), sizeof(uint32_t));
+    if (vertexOffset == StreamBuffer::FULL || indexOffset == StreamBuffer::FULL) return false;
+
+    range.baseVertex = static_cast<uint32_t>(vertexOffset / stride);
+    range.vertexCount = vertexCount;
+    range.firstIndex = static_cast<uint32_t>(indexOffset / sizeof(uint32_t));
+    range.indexCount = indexCount;
+    return true;
+}
+
+void GeometryPool::EndFrame()
+{
+    for (StreamArena& stream : streams)
+    {
+        if (!stream.frameOpen) continue;
+        stream.vertices->EndFrame();
+        stream.indices->EndFrame();
+        stream.frameOpen = false;
+    }
+}
+
+void GeometryPool::setupAttributes(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::Standard:
+        // vertex positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        break;
+    case VertexFormat::Packed:
+        // positions in [0, 1] of the mesh box; the renderer folds the box into the model matrix
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex),
+            (void*)offsetof(PackedVertex, position));
+        // normals: xyz of a signed normalized 2_10_10_10 word (w unused)
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex),
+            (void*)offsetof(PackedVertex, normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex),
+            (void*)offsetof(PackedVertex, texCoords));
+        break;
+    default:
+        break;
+    }
+}
+
+void GeometryPool::Compact()
+{
+    for (int f = 0; f < static_cast<int>(VertexFormat::Count); ++f)
+    {
+        Arena& arena = arenas[f];
+        if (arena.vao && !(arena.vertices.IsPacked() && arena.indices.IsPacked()))
+            repack(static_cast<VertexFormat>(f), arena.vertices.capacity, arena.indices.capacity);
+    }
+}
+
+void GeometryPool::Clear()
+{
+    for (Arena& arena : arenas)
+    {
+        if (arena.vao)
+        {
+            GLState::ForgetVertexArray(arena.vao);
+            glDeleteVertexArrays(1, &arena.vao);
+        }
+        if (arena.vbo) glDeleteBuffers(1, &arena.vbo);
+        if (arena.ebo) glDeleteBuffers(1, &arena.ebo);
+        arena = Arena();
+    }
+    for (StreamArena& stream : streams)
+    {
+        if (stream.vao)
+        {
+            GLState::ForgetVertexArray(stream.vao);
+            glDeleteVertexArrays(1, &stream.vao);
+        }
+        stream = StreamArena();
+    }
+    ranges.clear();
+    freeHandles.clear();
+}
+
+GeometryPool::Stats GeometryPool::GetStats()
+{
+    Stats stats;
+    for (int f = 0; f < static_cast<int>(VertexFormat::Count); ++f)
+    {
+        const Arena& arena = arenas[f];
+        stats.vertexCapacity += arena.vertices.capacity;
+        stats.verticesUsed += arena.vertices.used;
+        stats.vertexBytesUsed += arena.vertices.used * vertexStride(static_cast<VertexFormat>(f));
+        stats.indexBytesCapacity += arena.indices.capacity * INDEX_WORD;
+        stats.indexBytesUsed += arena.indices.used * INDEX_WORD;
+        stats.freeBlocks += static_cast<uint32_t>(arena.vertices.blocks.size() + arena.indices.blocks.size());
+    }
+    stats.repacks = repackCount;
+    return stats;
+}
@@ -1,62 +1,316 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <array>
+#include <iostream>
+#include <glm/gtc/packing.hpp>
 #include "core/rendering/Mesh.h"
+#include "core/rendering/geometry/MeshOptimizer.h"
+#include "core/rendering/geometry/MeshSimplifier.h"
+#include "core/rendering/geometry/MeshletBuilder.h"
+#include "core/rendering/geometry/BVH.h"
+#include "core/rendering/TextureUploader.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices) : 
-    vertices(vertices), indices(indices)
+// LOD levels stop below this many triangles, or when their error would exceed
+// this fraction of the mesh's bounding radius
+static constexpr size_t MIN_LOD_TRIANGLES = 64;
+static constexpr float MAX_LOD_ERROR = 0.1f;
+
+// Reorder for the post-transform cache, overdraw and vertex fetch before upload
+static void optimizeGeometry(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
 {
-    setupMesh();
+    if (indices.empty()) return;
+
+    MeshOptimizer::Report report = MeshOptimizer::Optimize(vertices, indices);
+    if (!report.optimized) {
+        std::cerr << "MeshOptimizer: skipped mesh with invalid indices\n";
+        return;
+    }
+#ifdef PYRE_VERBOSE
+    // one line per mesh, so only in verbose builds
+    std::cout << "MeshOptimizer: " << report.triangles << " triangles, ACMR "
+        << report.acmrBefore << " -> " << report.acmrAfter << "\n";
+#endif
 }
 
-void Mesh::setupMesh()
+// Quantizes positions to 16 bits inside [bias, bias + scale]
+static std::vector<PackedVertex> packVertices(const std::vector<Vertex>& vertices,
+    const glm::vec3& scale, const glm::vec3& bias)
 {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    const glm::vec3 invScale = 1.0f / scale;
+
+    std::vector<PackedVertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const Vertex& v = vertices[i];
+        glm::vec3 q = glm::clamp((v.Position - bias) * invScale, 0.0f, 1.0f) * 65535.0f + 0.5f;
 
-    glBindVertexArray(VAO);
+        PackedVertex& p = packed[i];
+        p.position[0] = static_cast<uint16_t>(q.x);
+        p.position[1] = static_cast<uint16_t>(q.y);
+        p.position[2] = static_cast<uint16_t>(q.z);
+        p.position[3] = 0;
+        p.normal = glm::packSnorm3x10_1x2(glm::vec4(v.Normal, 0.0f));
+        p.texCoords = glm::packHalf2x16(v.TexCoords);
+    }
+    return packed;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-        &vertices[0], GL_STATIC_DRAW);
+size_t Mesh::releasedCpuBytes = 0;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-        &indices[0], GL_STATIC_DRAW);
+MeshData::MeshData() = default;
+MeshData::~MeshData() = default;
+MeshData::MeshData(MeshData&&) noexcept = default;
+MeshData& MeshData::operator=(MeshData&&) noexcept = default;
+
+MeshData Mesh::Prepare(std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices,
+    const MeshOptions& options)
+{
+    MeshData data;
+    data.vertices = std::move(vertices);
+    data.indices = std::move(indices);
+    data.format = options.format;
+    data.keepCpuData = options.keepCpuData;
 
-    // vertex positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-        (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-        (void*)offsetof(Vertex, Normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-        (void*)offsetof(Vertex, TexCoords));
-    glBindVertexArray(0);
+    optimizeGeometry(data.vertices, data.indices);
+    if (options.meshlets)
+        *options.meshlets = MeshletBuilder::Build(data.vertices, data.indices);
+    if (options.lodLevels > 0 && !data.vertices.empty())
+    {
+        Bounds bounds = Bounds::FromPositions(&data.vertices[0].Position.x, data.vertices.size(),
+            sizeof(Vertex) / sizeof(float));
+        buildLods(data, bounds, options.lodLevels);
+    }
+    if (options.buildBvh)
+        data.bvh = std::make_unique<MeshBVH>(data.vertices, data.indices);
+    return data;
+}
+
+Mesh::Mesh(std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices,
+    const MeshOptions& options)
+    : Mesh(Prepare(std::move(vertices), std::move(indices), options))
+{
+}
+
+Mesh::Mesh(MeshData&& data) : format(data.format), lodError(data.lodError)
+{
+    setupMesh(data.vertices, data.indices);
+    lods.reserve(data.lods.size());
+    for (MeshData& lod : data.lods)
+        lods.emplace_back(std::move(lod));
+    bvh = std::move(data.bvh);
+
+    if (data.keepCpuData) {
+        this->vertices = std::move(data.vertices);
+        this->indices = std::move(data.indices);
+    }
+    else {
+        // these copies used to stay resident for the life of the mesh
+        releasedCpuBytes += data.vertices.capacity() * sizeof(Vertex)
+            + data.indices.capacity() * sizeof(unsigned int);
+        data.vertices = {};
+        data.indices = {};
+    }
+}
+
+// out of line: MeshBVH is only forward-declared in the header
+Mesh::Mesh() = default;
+
+Mesh::~Mesh()
+{
+    Destroy();
+}
+
+Mesh::Mesh(Mesh&& other) noexcept
+{
+    steal(other);
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept
+{
+    if (this != &other) {
+        Destroy();
+        steal(other);
+    }
+    return *this;
+}
+
+void Mesh::steal(Mesh& other) noexcept
+{
+    vertices = std::move(other.vertices);
+    indices = std::move(other.indices);
+    geometry = other.geometry;
+    VAO = other.VAO;
+    vertexCount = other.vertexCount;
+    indexCount = other.indexCount;
+    format = other.format;
+    positionScale = other.positionScale;
+    positionBias = other.positionBias;
+    bounds = other.bounds;
+    lods = std::move(other.lods);
+    lodError = other.lodError;
+    bvh = std::move(other.bvh);
+
+    other.geometry = GeometryPool::INVALID;
+    other.VAO = 0;
+    other.vertexCount = 0;
+    other.indexCount = 0;
+}
+
+MeshBlocks Mesh::Encode(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    VertexFormat format, std::vector<PackedVertex>& storage)
+{
+    MeshBlocks blocks;
+    if (!vertices.empty())
+        blocks.bounds = Bounds::FromPositions(&vertices[0].Position.x, vertices.size(),
+            sizeof(Vertex) / sizeof(float));
+    blocks.vertexCount = static_cast<uint32_t>(vertices.size());
+    blocks.indices = indices.data();
+    blocks.indexCount = static_cast<uint32_t>(indices.size());
+
+    if (format == VertexFormat::Packed && blocks.bounds.valid)
+    {
+        // flat axes keep a non-zero scale so decoding never divides by zero
+        blocks.format = VertexFormat::Packed;
+        blocks.positionBias = blocks.bounds.min;
+        blocks.positionScale = glm::max(blocks.bounds.max - blocks.bounds.min, glm::vec3(1e-6f));
+        storage = packVertices(vertices, blocks.positionScale, blocks.positionBias);
+        blocks.vertices = storage.data();
+    }
+    else
+    {
+        blocks.format = VertexFormat::Standard;
+        blocks.vertices = vertices.data();
+    }
+    return blocks;
+}
+
+Mesh::Mesh(const MeshBlocks& blocks) : lodError(blocks.lodError)
+{
+    upload(blocks);
+    // the blocks' owner (a mapped cache file, an Encode() buffer) lets go of them after upload
+    releasedCpuBytes += size_t(blocks.vertexCount)
+        * (blocks.format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex))
+        + size_t(blocks.indexCount) * sizeof(unsigned int);
+}
+
+// Computes bounds and copies the data into the pool in this mesh's vertex format
+void Mesh::setupMesh(const std::vector<Vertex>& vertexData, const std::vector<unsigned int>& indexData)
+{
+    std::vector<PackedVertex> packed;
+    upload(Encode(vertexData, indexData, format, packed));
+}
+
+void Mesh::upload(const MeshBlocks& blocks)
+{
+    format = blocks.format;
+    bounds = blocks.bounds;
+    positionScale = blocks.positionScale;
+    positionBias = blocks.positionBias;
+    geometry = GeometryPool::Allocate(format, blocks.vertices, blocks.vertexCount,
+        blocks.indices, blocks.indexCount);
+    VAO = GeometryPool::GetVertexArray(format);
+    vertexCount = static_cast<int>(blocks.vertexCount);
+    indexCount = static_cast<int>(blocks.indexCount);
+}
+
+// model * translate(bias) * scale(scale), without the matrix products
+glm::mat4 Mesh::DecodeModel(const glm::mat4& model) const
+{
+    if (format != VertexFormat::Packed) return model;
+
+    glm::mat4 m = model;
+    m[3] = model * glm::vec4(positionBias, 1.0f);
+    m[0] *= positionScale.x;
+    m[1] *= positionScale.y;
+    m[2] *= positionScale.z;
+    return m;
 }
 
 // Mesh::DrawSimple - just bind and issue draw call (no texture binding/no shader use)
+// Every mesh of a vertex format shares the pool's VAO, so consecutive draws never rebind it.
 void Mesh::DrawSimple() const
 {
-    glBindVertexArray(VAO);
-    if (!indices.empty())
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-    else if (indexCount > 0)
-        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    if (geometry == GeometryPool::INVALID) return;
+    const GeometryRange& range = GeometryPool::Get(geometry);
+
+    GLState::BindVertexArray(VAO);
+    if (range.indexCount > 0)
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, range.IndexType(),
+            (void*)range.IndexOffset(), range.baseVertex);
     else
-        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
-    glBindVertexArray(0);
+        glDrawArrays(GL_TRIANGLES, range.baseVertex, range.vertexCount);
+}
+
+void Mesh::DrawInstanced(int instanceCount) const
+{
+    if (geometry == GeometryPool::INVALID) return;
+    const GeometryRange& range = GeometryPool::Get(geometry);
+
+    GLState::BindVertexArray(VAO);
+    if (range.indexCount > 0)
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, range.IndexType(),
+            (void*)range.IndexOffset(), instanceCount, range.baseVertex);
+    else
+        glDrawArraysInstanced(GL_TRIANGLES, range.baseVertex, range.vertexCount, instanceCount);
+}
+
+void Mesh::DrawRanges(const IndexRange* ranges, uint32_t rangeCount) const
+{
+    if (geometry == GeometryPool::INVALID || rangeCount == 0) return;
+    const GeometryRange& range = GeometryPool::Get(geometry);
+    if (range.indexCount == 0) return;
+
+    // scratch arrays for the call, reused between draws (render thread only)
+    static std::vector<GLsizei> counts;
+    static std::vector<const void*> offsets;
+    static std::vector<GLint> baseVertices;
+    counts.resize(rangeCount);
+    offsets.resize(rangeCount);
+    baseVertices.assign(rangeCount, static_cast<GLint>(range.baseVertex));
+    for (uint32_t i = 0; i < rangeCount; ++i)
+    {
+        counts[i] = static_cast<GLsizei>(ranges[i].count);
+        offsets[i] = (const void*)(uintptr_t)((range.firstIndex + ranges[i].first) * range.indexSize);
+    }
+
+    GLState::BindVertexArray(VAO);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), range.IndexType(),
+        offsets.data(), static_cast<GLsizei>(rangeCount), baseVertices.data());
 }
 
 void Mesh::Draw(Shader& shader, Material& material) const
 {
     shader.use();
+    ApplyMaterial(shader, material);
+
+    // ---------------------------
+    // Draw
+    // ---------------------------
+    DrawSimple();
+}
+
+void Mesh::ApplyMaterial(Shader& shader, const Material& material)
+{
+    BindMaterialTextures(shader, material);
+
+    // ---------------------------
+    // Send all material uniforms
+    // ---------------------------
+    // specialized variants bake the flags in and drop the color a map replaces
+    const bool specialized = shader.HasDefine("SPECIALIZED");
+    if (!specialized) {
+        shader.setBool("material.useDiffuseMap", material.useDiffuseMap);
+        shader.setBool("material.useSpecularMap", material.useSpecularMap);
+    }
+    if (!specialized || !material.useDiffuseMap)
+        shader.setVec3("material.diffuseColor", material.diffuseColor);
+    if (!specialized || !material.useSpecularMap)
+        shader.setVec3("material.specularColor", material.specularColor);
+    shader.setFloat("material.shininess", material.shininess);
+}
 
+void Mesh::BindMaterialTextures(Shader& shader, const Material& material)
+{
     // ---------------------------
     // Handle texture binding
     // ---------------------------
@@ -64,117 +318,133 @@ void Mesh::Draw(Shader& shader, Material& material) const
     unsigned int specularID = 0;
 
     for (const auto& tex : material.textures) {
+        // textures still streaming in sample the placeholder
+        unsigned int id = tex->ready ? tex->ID : TextureUploader::Placeholder();
         if (tex -> type == TextureType::TEX_DIFFUSE && diffuseID == 0)
-            diffuseID = tex -> ID;
+            diffuseID = id;
         else if (tex -> type == TextureType::TEX_SPECULAR && specularID == 0)
-            specularID = tex -> ID;
+            specularID = id;
     }
 
-    // Bind textures (if available)
+    // Bind textures (if available); the state cache drops binds that change nothing
     if (material.useDiffuseMap && diffuseID != 0) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseID);
+        GLState::BindTexture(0, diffuseID);
         shader.setInt("material.diffuse", 0);
     }
     else {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, 0); // no texture
+        GLState::BindTexture(0, 0); // no texture
     }
 
     if (material.useSpecularMap && specularID != 0) {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, specularID);
+        GLState::BindTexture(1, specularID);
         shader.setInt("material.specular", 1);
     }
     else {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::BindTexture(1, 0);
     }
-
-    // ---------------------------
-    // Send all material uniforms
-    // ---------------------------
-    shader.setBool("material.useDiffuseMap", material.useDiffuseMap);
-    shader.setBool("material.useSpecularMap", material.useSpecularMap);
-    shader.setVec3("material.diffuseColor", material.diffuseColor);
-    shader.setVec3("material.specularColor", material.specularColor);
-    shader.setFloat("material.shininess", material.shininess);
-
-    // ---------------------------
-    // Draw
-    // ---------------------------
-    glBindVertexArray(VAO);
-    if (!indices.empty())
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-    else if (indexCount > 0)
-        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
-    else
-        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
-    glBindVertexArray(0);
-
-    // ---------------------------
-    // Reset state
-    // ---------------------------
-    glActiveTexture(GL_TEXTURE0);
 }
 
-Mesh Mesh::CreateFromData(const float* vertices, std::size_t bytes, int vCount) 
+Mesh Mesh::CreateFromData(const float* vertices, int vCount)
 {
+    // Layout: pos(0) normal(1) tex(2), stride = 8 floats (same as Vertex)
     Mesh m;
-    glGenVertexArrays(1, &m.VAO);
-    glGenBuffers(1, &m.VBO);
-
-    glBindVertexArray(m.VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m.VBO);
-    glBufferData(GL_ARRAY_BUFFER, bytes, vertices, GL_STATIC_DRAW);
-
-    // Layout: pos(0) normal(1) tex(2), stride = 8 floats
-    constexpr GLsizei stride = 8 * sizeof(float);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glBindVertexArray(0);
+    m.geometry = GeometryPool::Allocate(VertexFormat::Standard, vertices,
+        static_cast<uint32_t>(vCount), nullptr, 0);
+    m.VAO = GeometryPool::GetVertexArray(VertexFormat::Standard);
     m.vertexCount = vCount;
+    m.bounds = Bounds::FromPositions(vertices, vCount, 8);
+    // the caller's array is not kept either
+    releasedCpuBytes += size_t(vCount) * sizeof(Vertex);
     return m;
 }
 
 Mesh Mesh::CreateFromIndexedData(const float* vertices, std::size_t vBytes,
-    const unsigned int* indices, std::size_t iBytes, int iCount)
+    const unsigned int* indices, int iCount, const MeshOptions& options)
+{
+    const std::size_t vCount = vBytes / sizeof(Vertex);
+    std::vector<Vertex> vertexData(reinterpret_cast<const Vertex*>(vertices),
+        reinterpret_cast<const Vertex*>(vertices) + vCount);
+    std::vector<unsigned int> indexData(indices, indices + iCount);
+    return Mesh(Prepare(std::move(vertexData), std::move(indexData), options));
+}
+
+Mesh Mesh::CreateStreaming()
 {
     Mesh m;
-    glGenVertexArrays(1, &m.VAO);
-    glGenBuffers(1, &m.VBO);
-    glGenBuffers(1, &m.EBO);
+    m.geometry = GeometryPool::AllocateStream(VertexFormat::Standard);
+    m.VAO = GeometryPool::GetStreamVertexArray(VertexFormat::Standard);
+    return m;
+}
+
+bool Mesh::Stream(const Vertex* vertexData, uint32_t vertexCount,
+    const unsigned int* indexData, uint32_t indexCount)
+{
+    if (geometry == GeometryPool::INVALID || !GeometryPool::Get(geometry).streamed) return false;
 
-    glBindVertexArray(m.VAO);
+    bool written = GeometryPool::WriteStream(geometry, vertexData, vertexCount, indexData, indexCount);
+    const GeometryRange& range = GeometryPool::Get(geometry);
+    this->vertexCount = static_cast<int>(range.vertexCount);
+    this->indexCount = static_cast<int>(range.indexCount);
+    bounds = written && vertexData
+        ? Bounds::FromPositions(&vertexData[0].Position.x, vertexCount, sizeof(Vertex) / sizeof(float))
+        : Bounds();
+    return written;
+}
+
+void Mesh::Destroy() 
+{
+    // the VAO belongs to the pool; only the ranges are released
+    GeometryPool::Free(geometry);
+    geometry = GeometryPool::INVALID;
+    VAO = 0;
+    lods.clear();
+    bvh.reset();
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, m.VBO);
-    glBufferData(GL_ARRAY_BUFFER, vBytes, vertices, GL_STATIC_DRAW);
+// Each level is simplified from the full mesh (so errors do not stack up) and
+// reordered like any other mesh; it shares nothing with the full mesh on the GPU.
+void Mesh::buildLods(MeshData& data, const Bounds& bounds, int levels)
+{
+    if (levels <= 0 || data.indices.empty() || !bounds.valid) return;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, iBytes, indices, GL_STATIC_DRAW);
+    const float maxError = bounds.radius * MAX_LOD_ERROR;
+    size_t previous = data.indices.size();
+    for (int level = 1; level <= levels; ++level)
+    {
+        const size_t target = (data.indices.size() >> level) / 3 * 3;
+        if (target / 3 < MIN_LOD_TRIANGLES) break;
 
-    constexpr GLsizei stride = 8 * sizeof(float);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+        std::vector<unsigned int> lodIndices;
+        float error = MeshSimplifier::Simplify(data.vertices, data.indices, target, maxError, lodIndices);
+        // locked seams/borders or the error limit stopped it early: coarser levels would too
+        if (lodIndices.size() * 5 > previous * 4) break;
 
-    glBindVertexArray(0);
+        MeshData lod;
+        lod.vertices = data.vertices;
+        lod.indices = std::move(lodIndices);
+        lod.format = data.format;
+        lod.lodError = error;
+        MeshOptimizer::Optimize(lod.vertices, lod.indices);
+        previous = lod.indices.size();
+        data.lods.push_back(std::move(lod));
+    }
 
-    m.indexCount = iCount;
-    return m;
+#ifdef PYRE_VERBOSE
+    if (data.lods.empty()) return;
+    std::cout << "MeshSimplifier: LOD triangles " << data.indices.size() / 3;
+    for (const MeshData& lod : data.lods)
+        std::cout << " -> " << lod.indices.size() / 3;
+    std::cout << "\n";
+#endif
 }
 
-void Mesh::Destroy() 
+const Mesh& Mesh::SelectLod(float pixelsPerUnit, float maxPixels) const
 {
-    if (VBO) { glDeleteBuffers(1, &VBO); VBO = 0; }
-    if (VAO) { glDeleteVertexArrays(1, &VAO); VAO = 0; }
-    if (EBO) { glDeleteBuffers(1, &EBO); EBO = 0; }
-}
\ No newline at end of file
+    const Mesh* chosen = this;
+    for (const Mesh& lod : lods)
+    {
+        if (lod.lodError * pixelsPerUnit > maxPixels) break;
+        chosen = &lod;
+    }
+    return *chosen;
+}
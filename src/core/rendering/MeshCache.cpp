@@ -0,0 +1,418 @@
+#include "core/rendering/MeshCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include "core/rendering/geometry/BVH.h"
+
+namespace
+{
+    constexpr char MAGIC[4] = { 'P', 'M', 'S', 'H' };
+    // bump whenever the records or anything the import does to the data changes
+    constexpr uint32_t VERSION = 2;
+    constexpr size_t BLOCK_ALIGNMENT = 16;
+    constexpr size_t PREFETCH_STRIDE = 4096;
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // FNV-1a, so cache names do not depend on the standard library
+    uint64_t hashPath(const std::string& path)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : path)
+            hash = (hash ^ c) * 1099511628211ull;
+        return hash;
+    }
+
+    size_t vertexSize(uint32_t format)
+    {
+        return static_cast<VertexFormat>(format) == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    }
+
+    bool indicesValid(const unsigned int* indices, uint32_t indexCount, uint32_t vertexCount)
+    {
+        for (uint32_t i = 0; i < indexCount; ++i)
+            if (indices[i] >= vertexCount) return false;
+        return true;
+    }
+
+    // The builder stores children after their parent, so links that do not point
+    // forward are damage (and could loop). Leaves must stay inside the triangle
+    // arrays and no node may be deeper than the traversal stacks allow.
+    bool bvhValid(const BVH::Node* nodes, uint32_t nodeCount, const uint32_t* ids, uint32_t triangleCount,
+        uint32_t meshTriangles)
+    {
+        if (nodeCount == 0) return false;
+
+        std::vector<uint32_t> depth(nodeCount, 0);
+        for (uint32_t i = 0; i < nodeCount; ++i)
+        {
+            const BVH::Node& node = nodes[i];
+            if (node.IsLeaf())
+            {
+                if (uint64_t(node.leftOrFirst) + node.count > triangleCount) return false;
+                continue;
+            }
+            if (node.leftOrFirst <= i || uint64_t(node.leftOrFirst) + 1 >= nodeCount ||
+                depth[i] >= BVH::MAX_DEPTH)
+                return false;
+            for (uint32_t child = node.leftOrFirst; child <= node.leftOrFirst + 1; ++child)
+                depth[child] = std::max(depth[child], depth[i] + 1);
+        }
+        for (uint32_t i = 0; i < triangleCount; ++i)
+            if (ids[i] >= meshTriangles) return false;
+        return true;
+    }
+}
+
+bool MeshCache::MakeKey(const std::string& sourcePath, VertexFormat format, int lodLevels,
+    uint32_t meshletMinTriangles, bool buildBvh, Key& key)
+{
+    std::error_code error;
+    const auto size = std::filesystem::file_size(sourcePath, error);
+    if (error) return false;
+    const auto time = std::filesystem::last_write_time(sourcePath, error);
+    if (error) return false;
+
+    key.sourceSize = static_cast<uint64_t>(size);
+    key.sourceTime = static_cast<int64_t>(time.time_since_epoch().count());
+    key.format = static_cast<uint32_t>(format);
+    key.lodLevels = static_cast<uint32_t>(lodLevels);
+    key.meshletMinTriangles = meshletMinTriangles;
+    key.buildBvh = buildBvh ? 1 : 0;
+    return true;
+}
+
+std::string MeshCache::CachePath(const std::string& sourcePath)
+{
+    // the stem keeps the files recognizable; the hash keeps same-named models apart
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(hashPath(sourcePath)));
+    return std::string(CACHE_DIRECTORY) + "/" + std::filesystem::path(sourcePath).stem().string()
+        + "-" + hash + ".mesh";
+}
+
+std::unique_ptr<MeshCache> MeshCache::Open(const std::string& sourcePath, const Key& key)
+{
+    std::unique_ptr<MeshCache> cache(new MeshCache());
+    if (!cache->file.Open(CachePath(sourcePath))) return nullptr;
+    if (cache->file.Size() < sizeof(CacheHeader)) return nullptr;
+
+    const CacheHeader* header = cache->at<CacheHeader>(0);
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION)
+        return nullptr;
+    if (header->sourceSize != key.sourceSize || header->sourceTime != key.sourceTime ||
+        header->format != key.format || header->lodLevels != key.lodLevels ||
+        header->meshletMinTriangles != key.meshletMinTriangles || header->buildBvh != key.buildBvh)
+        return nullptr;
+
+    cache->header = header;
+    if (!cache->validate())
+    {
+        std::cerr << "MeshCache: ignoring damaged " << CachePath(sourcePath) << "\n";
+        return nullptr;
+    }
+    return cache;
+}
+
+// Every table and block must lie inside the file (a truncated write, a full disk),
+// and nothing in them may point outside what it indexes: vertices, index lists,
+// BVH nodes and triangles. The blocks are read once for that, which also pages them in.
+bool MeshCache::validate() const
+{
+    const uint64_t size = file.Size();
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t stride) {
+        return offset <= size && count <= (size - offset) / stride;
+    };
+
+    if (!fits(header->meshOffset, header->meshCount, sizeof(CacheMesh)) ||
+        !fits(header->levelOffset, header->levelCount, sizeof(CacheLevel)) ||
+        !fits(header->textureOffset, header->textureCount, sizeof(CacheTexture)) ||
+        !fits(header->stringOffset, header->stringBytes, 1))
+        return false;
+
+    for (uint32_t i = 0; i < header->levelCount; ++i)
+    {
+        const CacheLevel& level = at<CacheLevel>(header->levelOffset)[i];
+        if (level.format > static_cast<uint32_t>(VertexFormat::Packed) ||
+            !fits(level.vertexOffset, level.vertexCount, vertexSize(level.format)) ||
+            !fits(level.indexOffset, level.indexCount, sizeof(unsigned int)) ||
+            !indicesValid(at<unsigned int>(level.indexOffset), level.indexCount, level.vertexCount))
+            return false;
+    }
+    for (uint32_t i = 0; i < header->textureCount; ++i)
+    {
+        const CacheTexture& texture = at<CacheTexture>(header->textureOffset)[i];
+        if (uint64_t(texture.pathOffset) + texture.pathLength > header->stringBytes) return false;
+    }
+    for (uint32_t i = 0; i < header->meshCount; ++i)
+    {
+        const CacheMesh& mesh = at<CacheMesh>(header->meshOffset)[i];
+        if (mesh.levelCount == 0 ||
+            uint64_t(mesh.firstLevel) + mesh.levelCount > header->levelCount ||
+            uint64_t(mesh.firstTexture) + mesh.textureCount > header->textureCount ||
+            !fits(mesh.meshletOffset, mesh.meshletCount, sizeof(Meshlet)) ||
+            !fits(mesh.bvhNodeOffset, mesh.bvhNodeCount, sizeof(BVH::Node)) ||
+            !fits(mesh.bvhPositionOffset, uint64_t(mesh.bvhTriangleCount) * 3, sizeof(glm::vec3)) ||
+            !fits(mesh.bvhIdOffset, mesh.bvhTriangleCount, sizeof(uint32_t)))
+            return false;
+
+        // meshlets are runs of the full-detail level's index list
+        const CacheLevel& full = at<CacheLevel>(header->levelOffset)[mesh.firstLevel];
+        const Meshlet* meshlets = at<Meshlet>(mesh.meshletOffset);
+        for (uint32_t m = 0; m < mesh.meshletCount; ++m)
+            if (uint64_t(meshlets[m].firstIndex) + meshlets[m].indexCount > full.indexCount) return false;
+
+        if (mesh.bvhTriangleCount > 0 &&
+            !bvhValid(at<BVH::Node>(mesh.bvhNodeOffset), mesh.bvhNodeCount, at<uint32_t>(mesh.bvhIdOffset),
+                mesh.bvhTriangleCount, full.indexCount / 3))
+            return false;
+    }
+    return true;
+}
+
+size_t MeshCache::MeshCount() const
+{
+    return header->meshCount;
+}
+
+std::shared_ptr<Mesh> MeshCache::CreateMesh(size_t index) const
+{
+    const CacheMesh& record = at<CacheMesh>(header->meshOffset)[index];
+    const CacheLevel* levels = at<CacheLevel>(header->levelOffset) + record.firstLevel;
+
+    auto blocksOf = [this](const CacheLevel& level) {
+        MeshBlocks blocks;
+        blocks.format = static_cast<VertexFormat>(level.format);
+        blocks.vertices = file.Data() + level.vertexOffset;
+        blocks.vertexCount = level.vertexCount;
+        blocks.indices = at<unsigned int>(level.indexOffset);
+        blocks.indexCount = level.indexCount;
+        blocks.bounds.min = level.boundsMin;
+        blocks.bounds.max = level.boundsMax;
+        blocks.bounds.center = level.boundsCenter;
+        blocks.bounds.radius = level.boundsRadius;
+        blocks.bounds.valid = level.boundsValid != 0;
+        blocks.positionScale = level.positionScale;
+        blocks.positionBias = level.positionBias;
+        blocks.lodError = level.lodError;
+        return blocks;
+    };
+
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(blocksOf(levels[0]));
+    mesh->lods.reserve(record.levelCount - 1);
+    for (uint32_t i = 1; i < record.levelCount; ++i)
+        mesh->lods.emplace_back(blocksOf(levels[i]));
+    if (record.bvhTriangleCount > 0)
+        mesh->bvh = std::make_unique<MeshBVH>(at<BVH::Node>(record.bvhNodeOffset), record.bvhNodeCount,
+            at<glm::vec3>(record.bvhPositionOffset), at<uint32_t>(record.bvhIdOffset),
+            record.bvhTriangleCount);
+    return mesh;
+}
+
+std::vector<Meshlet> MeshCache::GetMeshlets(size_t index) const
+{
+    const CacheMesh& record = at<CacheMesh>(header->meshOffset)[index];
+    const Meshlet* meshlets = at<Meshlet>(record.meshletOffset);
+    return std::vector<Meshlet>(meshlets, meshlets + record.meshletCount);
+}
+
+Material MeshCache::GetMaterial(size_t index) const
+{
+    const CacheMesh& record = at<CacheMesh>(header->meshOffset)[index];
+    Material material;
+    material.diffuseColor = record.diffuseColor;
+    material.specularColor = record.specularColor;
+    material.shininess = record.shininess;
+    material.useDiffuseMap = (record.materialFlags & 1) != 0;
+    material.useSpecularMap = (record.materialFlags & 2) != 0;
+    return material;
+}
+
+std::vector<MeshCache::TextureRef> MeshCache::GetTextures(size_t index) const
+{
+    const CacheMesh& record = at<CacheMesh>(header->meshOffset)[index];
+    const CacheTexture* textures = at<CacheTexture>(header->textureOffset) + record.firstTexture;
+    const char* strings = at<char>(header->stringOffset);
+
+    std::vector<TextureRef> refs(record.textureCount);
+    for (uint32_t i = 0; i < record.textureCount; ++i)
+    {
+        refs[i].path.assign(strings + textures[i].pathOffset, textures[i].pathLength);
+        refs[i].type = static_cast<TextureType>(textures[i].type);
+    }
+    return refs;
+}
+
+void MeshCache::Prefetch(size_t index) const
+{
+    const CacheMesh& record = at<CacheMesh>(header->meshOffset)[index];
+    const CacheLevel* levels = at<CacheLevel>(header->levelOffset) + record.firstLevel;
+
+    // one read per page is enough to fault it in
+    auto touch = [this](uint64_t offset, size_t bytes) {
+        unsigned char sum = 0;
+        for (size_t i = 0; i < bytes; i += PREFETCH_STRIDE)
+            sum += file.Data()[offset + i];
+        volatile unsigned char sink = sum;
+        (void)sink;
+    };
+    for (uint32_t i = 0; i < record.levelCount; ++i)
+    {
+        touch(levels[i].vertexOffset, levels[i].vertexCount * vertexSize(levels[i].format));
+        touch(levels[i].indexOffset, levels[i].indexCount * sizeof(unsigned int));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Writer
+// ----------------------------------------------------------------------------
+size_t MeshCache::Writer::append(const void* bytes, size_t size)
+{
+    const size_t offset = alignUp(blocks.size(), BLOCK_ALIGNMENT);
+    blocks.resize(offset + size);
+    if (size > 0) std::memcpy(blocks.data() + offset, bytes, size);
+    return offset;
+}
+
+void MeshCache::Writer::Add(const MeshData& data, const std::vector<Meshlet>& meshlets,
+    const Material& material, const std::vector<TextureRef>& textureRefs)
+{
+    CacheMesh mesh{};
+    mesh.firstLevel = static_cast<uint32_t>(levels.size());
+    mesh.levelCount = static_cast<uint32_t>(1 + data.lods.size());
+
+    // offsets are relative to the data blocks until Save() places them
+    auto addLevel = [this](const MeshData& levelData) {
+        std::vector<PackedVertex> packed;
+        MeshBlocks blocks = Mesh::Encode(levelData.vertices, levelData.indices, levelData.format, packed);
+
+        CacheLevel level{};
+        level.vertexCount = blocks.vertexCount;
+        level.indexCount = blocks.indexCount;
+        level.format = static_cast<uint32_t>(blocks.format);
+        level.vertexOffset = append(blocks.vertices, blocks.vertexCount * vertexSize(level.format));
+        level.indexOffset = append(blocks.indices, blocks.indexCount * sizeof(unsigned int));
+        level.lodError = levelData.lodError;
+        level.boundsMin = blocks.bounds.min;
+        level.boundsMax = blocks.bounds.max;
+        level.boundsCenter = blocks.bounds.center;
+        level.boundsRadius = blocks.bounds.radius;
+        level.boundsValid = blocks.bounds.valid ? 1 : 0;
+        level.positionScale = blocks.positionScale;
+        level.positionBias = blocks.positionBias;
+        levels.push_back(level);
+    };
+    addLevel(data);
+    for (const MeshData& lod : data.lods)
+        addLevel(lod);
+
+    mesh.meshletCount = static_cast<uint32_t>(meshlets.size());
+    mesh.meshletOffset = append(meshlets.data(), meshlets.size() * sizeof(Meshlet));
+    if (data.bvh)
+    {
+        const MeshBVH& bvh = *data.bvh;
+        mesh.bvhNodeCount = static_cast<uint32_t>(bvh.Nodes().size());
+        mesh.bvhTriangleCount = static_cast<uint32_t>(bvh.Ids().size());
+        mesh.bvhNodeOffset = append(bvh.Nodes().data(), bvh.Nodes().size() * sizeof(BVH::Node));
+        mesh.bvhPositionOffset = append(bvh.Positions().data(), bvh.Positions().size() * sizeof(glm::vec3));
+        mesh.bvhIdOffset = append(bvh.Ids().data(), bvh.Ids().size() * sizeof(uint32_t));
+    }
+
+    mesh.firstTexture = static_cast<uint32_t>(textures.size());
+    mesh.textureCount = static_cast<uint32_t>(textureRefs.size());
+    for (const TextureRef& ref : textureRefs)
+    {
+        CacheTexture texture{};
+        texture.type = static_cast<uint32_t>(ref.type);
+        texture.pathOffset = static_cast<uint32_t>(strings.size());
+        texture.pathLength = static_cast<uint32_t>(ref.path.size());
+        strings += ref.path;
+        textures.push_back(texture);
+    }
+
+    mesh.diffuseColor = material.diffuseColor;
+    mesh.specularColor = material.specularColor;
+    mesh.shininess = material.shininess;
+    mesh.materialFlags = (material.useDiffuseMap ? 1u : 0u) | (material.useSpecularMap ? 2u : 0u);
+    meshes.push_back(mesh);
+}
+
+bool MeshCache::Writer::Save(const std::string& sourcePath, const Key& key) const
+{
+    CacheHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.sourceSize = key.sourceSize;
+    header.sourceTime = key.sourceTime;
+    header.format = key.format;
+    header.lodLevels = key.lodLevels;
+    header.meshletMinTriangles = key.meshletMinTriangles;
+    header.buildBvh = key.buildBvh;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.textureCount = static_cast<uint32_t>(textures.size());
+    header.meshOffset = sizeof(CacheHeader);
+    header.levelOffset = header.meshOffset + meshes.size() * sizeof(CacheMesh);
+    header.textureOffset = header.levelOffset + levels.size() * sizeof(CacheLevel);
+    header.stringOffset = header.textureOffset + textures.size() * sizeof(CacheTexture);
+    header.stringBytes = strings.size();
+    const uint64_t blockStart = alignUp(header.stringOffset + header.stringBytes, BLOCK_ALIGNMENT);
+
+    std::vector<CacheMesh> placedMeshes = meshes;
+    for (CacheMesh& mesh : placedMeshes)
+    {
+        mesh.meshletOffset += blockStart;
+        mesh.bvhNodeOffset += blockStart;
+        mesh.bvhPositionOffset += blockStart;
+        mesh.bvhIdOffset += blockStart;
+    }
+    std::vector<CacheLevel> placedLevels = levels;
+    for (CacheLevel& level : placedLevels)
+    {
+        level.vertexOffset += blockStart;
+        level.indexOffset += blockStart;
+    }
+
+    const std::string path = CachePath(sourcePath);
+    std::error_code error;
+    std::filesystem::create_directories(CACHE_DIRECTORY, error);
+
+    // written under another name and renamed, so no one maps a half-written file
+    const std::string partial = path + ".part";
+    {
+        std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+        const char zeros[BLOCK_ALIGNMENT] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(placedMeshes.data()), placedMeshes.size() * sizeof(CacheMesh));
+        out.write(reinterpret_cast<const char*>(placedLevels.data()), placedLevels.size() * sizeof(CacheLevel));
+        out.write(reinterpret_cast<const char*>(textures.data()), textures.size() * sizeof(CacheTexture));
+        out.write(strings.data(), strings.size());
+        out.write(zeros, blockStart - (header.stringOffset + header.stringBytes));
+        out.write(reinterpret_cast<const char*>(blocks.data()), blocks.size());
+        if (!out)
+        {
+            std::cerr << "MeshCache: cannot write " << partial << "\n";
+            out.close();
+            std::filesystem::remove(partial, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(partial, path, error);
+    if (error)
+    {
+        std::cerr << "MeshCache: cannot replace " << path << ": " << error.message() << "\n";
+        std::filesystem::remove(partial, error);
+        return false;
+    }
+#ifdef PYRE_VERBOSE
+    std::cout << "MeshCache: wrote " << path << " (" << (blockStart + blocks.size()) / 1024 << " KB)\n";
+#endif
+    return true;
+}
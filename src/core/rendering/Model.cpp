@@ -1,17 +1,118 @@
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
 #include "core/rendering/Model.h"
 #include "helpers/shaderClass.h"
 #include "core/ResourceManager.h"
+#include "core/rendering/MeshCache.h"
+#include "core/rendering/TextureUploader.h"
 
-void Model::Draw(Shader& shader)
+// A material texture found by the import, decoding on the ImageDecoder pool
+struct Model::PendingTexture
 {
-	for (unsigned int i = 0; i < meshes.size(); i++)
-		meshes[i].mesh -> Draw(shader, *meshes[i].material);
+	std::string path;
+	TextureType type;
+	std::shared_ptr<const ImageDecoder::Job> job;	// shared by every mesh using the file
+};
+
+// One imported mesh, prepared on the CPU and waiting for upload
+struct Model::PendingMesh
+{
+	static constexpr size_t FRESH = SIZE_MAX;
+
+	size_t cacheIndex = FRESH;	// mesh of Loader::cache to upload, or FRESH for data
+	MeshData data;
+	std::vector<Meshlet> meshlets;
+	Material material;	// without textures
+	std::vector<PendingTexture> textures;
+};
+
+struct Model::Loader
+{
+	std::thread thread;
+	std::mutex mutex;
+	std::deque<PendingMesh> ready;	// guarded by mutex
+	// decodes requested ahead of the meshes that use them (loader thread only)
+	std::map<std::string, std::shared_ptr<const ImageDecoder::Job>> images;
+	// cooked file the queued meshes are uploaded from (set before the first push)
+	std::unique_ptr<MeshCache> cache;
+	// collects a fresh import for the cache (loader thread only)
+	MeshCache::Writer writer;
+	bool cooking = false;
+	std::atomic<bool> done{ false };	// set after the last mesh is queued
+	std::atomic<bool> failed{ false };
+	std::atomic<bool> cancel{ false };
+};
+
+std::vector<Model*> Model::loading;
+
+Model::Model(const std::string& path, VertexFormat format, LoadMode mode, bool buildBvh)
+	: format(format), buildBvh(buildBvh), path(path), loader(std::make_unique<Loader>())
+{
+	if (mode == LoadMode::Async)
+	{
+		loader->thread = std::thread([this] { importModel(); });
+		loading.push_back(this);
+		return;
+	}
+
+	// same stages, run back to back
+	importModel();
+	while (uploadNext(true)) {}
+	// a blocking load comes back with its textures in place
+	TextureUploader::Flush();
+	finishLoad();
 }
 
-void Model::loadModel(std::string path)
+Model::~Model()
 {
+	if (!loader) return;
+
+	loader->cancel = true;
+	if (loader->thread.joinable())
+		loader->thread.join();
+	loading.erase(std::remove(loading.begin(), loading.end(), this), loading.end());
+}
+
+void Model::UploadPending(double budgetMs)
+{
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	auto elapsedMs = [&] {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	bool uploaded = false;
+	for (size_t i = 0; i < loading.size();)
+	{
+		Model* model = loading[i];
+		// the first mesh goes regardless, so a tight budget still makes progress
+		while ((!uploaded || elapsedMs() < budgetMs) && model->uploadNext(false))
+			uploaded = true;
+
+		if (model->loadFinished())
+		{
+			model->finishLoad();
+			loading.erase(loading.begin() + i);
+		}
+		else
+			++i;
+	}
+}
+
+void Model::importModel()
+{
+	MeshCache::Key key;
+	loader->cooking = MeshCache::MakeKey(path, format, MODEL_LOD_LEVELS, MODEL_MESHLET_MIN_TRIANGLES,
+		buildBvh, key);
+	if (loader->cooking && importCached(key)) return;
+
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate |
 		aiProcess_FlipUVs);
@@ -20,11 +121,141 @@ void Model::loadModel(std::string path)
 		!scene->mRootNode)
 	{
 		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+		loader->failed = true;
+		loader->done = true;
 		return;
 	}
 
 	directory = std::filesystem::path(path).parent_path().string();
+
+	// every texture file starts decoding now, in parallel with the mesh processing
+	for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+	{
+		std::vector<PendingTexture> textures;
+		loadMaterialTextures(scene->mMaterials[i], aiTextureType_DIFFUSE, TextureType::TEX_DIFFUSE, textures);
+		loadMaterialTextures(scene->mMaterials[i], aiTextureType_SPECULAR, TextureType::TEX_SPECULAR, textures);
+	}
 	processNode(scene->mRootNode, scene);
+	if (loader->cooking && !loader->cancel)
+		loader->writer.Save(path, key);
+
+	// queued meshes keep the images they use alive
+	loader->writer = {};
+	loader->images.clear();
+	loader->done = true;
+}
+
+bool Model::importCached(const MeshCache::Key& key)
+{
+	loader->cache = MeshCache::Open(path, key);
+	if (!loader->cache) return false;
+
+	const MeshCache& cache = *loader->cache;
+#ifdef PYRE_VERBOSE
+	std::cout << "Model: " << path << " from " << MeshCache::CachePath(path) << "\n";
+#endif
+	// every texture file starts decoding before the geometry is read in
+	std::vector<PendingMesh> queued(cache.MeshCount());
+	for (size_t i = 0; i < queued.size(); ++i)
+	{
+		queued[i].cacheIndex = i;
+		for (const MeshCache::TextureRef& ref : cache.GetTextures(i))
+			queued[i].textures.push_back(decodeTexture(ref.path, ref.type));
+	}
+	for (size_t i = 0; i < queued.size() && !loader->cancel; ++i)
+	{
+		PendingMesh& pending = queued[i];
+		pending.material = cache.GetMaterial(i);
+		pending.meshlets = cache.GetMeshlets(i);
+		cache.Prefetch(i);
+
+		std::lock_guard<std::mutex> lock(loader->mutex);
+		loader->ready.push_back(std::move(pending));
+	}
+
+	loader->images.clear();
+	loader->done = true;
+	return true;
+}
+
+Model::PendingTexture Model::decodeTexture(const std::string& texturePath, TextureType type)
+{
+	std::shared_ptr<const ImageDecoder::Job>& job = loader->images[texturePath];
+	if (!job)
+		job = ImageDecoder::Decode(texturePath);
+	return { texturePath, type, job };
+}
+
+bool Model::uploadNext(bool wait)
+{
+	PendingMesh pending;
+	{
+		std::lock_guard<std::mutex> lock(loader->mutex);
+		if (loader->ready.empty()) return false;
+
+		// meshes appear once their textures are decoded, so one still decoding holds the
+		// queue up (the pixels then stream in through TextureUploader)
+		if (!wait)
+			for (const PendingTexture& texture : loader->ready.front().textures)
+				if (!texture.job->Ready() && !ResourceManager::GetTexture(texture.path))
+					return false;
+
+		pending = std::move(loader->ready.front());
+		loader->ready.pop_front();
+	}
+
+	MeshEntry entry;
+	for (const PendingTexture& texture : pending.textures)
+	{
+		// files already loaded by another model come from the cache
+		if (!ResourceManager::GetTexture(texture.path))
+			ImageDecoder::Wait(*texture.job);
+		std::shared_ptr<Texture> uploaded = ResourceManager::CreateTexture(texture.path, texture.type,
+			texture.job);
+		if (uploaded)
+			pending.material.textures.push_back(uploaded);
+	}
+
+	const size_t releasedBefore = Mesh::ReleasedCpuBytes();
+	if (pending.cacheIndex != PendingMesh::FRESH)
+		entry.mesh = loader->cache->CreateMesh(pending.cacheIndex);
+	else
+		entry.mesh = std::make_shared<Mesh>(std::move(pending.data));
+	releasedBytes += Mesh::ReleasedCpuBytes() - releasedBefore;
+	entry.material = std::make_shared<Material>(std::move(pending.material));
+	entry.meshlets = std::move(pending.meshlets);
+
+	bounds.Merge(entry.mesh->bounds);
+	meshes.push_back(std::move(entry));
+	state = ModelState::Partial;
+	return true;
+}
+
+bool Model::loadFinished() const
+{
+	// done is set after the last push, so an empty queue seen after it stays empty
+	if (!loader->done) return false;
+	std::lock_guard<std::mutex> lock(loader->mutex);
+	return loader->ready.empty();
+}
+
+void Model::finishLoad()
+{
+	if (loader->thread.joinable())
+		loader->thread.join();
+	state = loader->failed ? ModelState::Failed : ModelState::Ready;
+	loader.reset();
+#ifdef PYRE_VERBOSE
+	if (state == ModelState::Failed) return;
+
+	size_t meshletCount = 0;
+	for (const MeshEntry& entry : meshes)
+		meshletCount += entry.meshlets.size();
+
+	std::cout << "Model: " << path << " - " << meshes.size() << " meshes, "
+		<< meshletCount << " meshlets, "
+		<< releasedBytes / 1024 << " KB of CPU geometry freed after upload\n";
+#endif
 }
 
 void Model::processNode(aiNode* node, const aiScene* scene)
@@ -32,8 +263,9 @@ void Model::processNode(aiNode* node, const aiScene* scene)
 	// process all the nodes meshes (if any)
 	for (unsigned int i = 0; i < node->mNumMeshes; i++)
 	{
+		if (loader->cancel) return;
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+		processMesh(mesh, scene);
 	}
 	// then do the same for each of its children
 	for (unsigned int i = 0; i < node->mNumChildren; i++)
@@ -42,11 +274,11 @@ void Model::processNode(aiNode* node, const aiScene* scene)
 	}
 }
 
-MeshEntry Model::processMesh(aiMesh* mesh, const aiScene* scene)
+void Model::processMesh(aiMesh* mesh, const aiScene* scene)
 {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+    PendingMesh pending;
 
     // ---- Vertices ----
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -86,7 +318,7 @@ MeshEntry Model::processMesh(aiMesh* mesh, const aiScene* scene)
     }
 
     // ---- Material ----
-    Material mat;
+    Material& mat = pending.material;
     mat.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
     mat.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
     mat.shininess = 32.0f;
@@ -98,22 +330,14 @@ MeshEntry Model::processMesh(aiMesh* mesh, const aiScene* scene)
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
         // Diffuse
-        std::vector<std::shared_ptr<Texture>> diffuseMaps =
-            loadMaterialTextures(material, aiTextureType_DIFFUSE, TextureType::TEX_DIFFUSE);
-        if (!diffuseMaps.empty())
-        {
-            mat.textures.insert(mat.textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-            mat.useDiffuseMap = true;
-        }
+        size_t before = pending.textures.size();
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, TextureType::TEX_DIFFUSE, pending.textures);
+        mat.useDiffuseMap = pending.textures.size() > before;
 
         // Specular
-        std::vector<std::shared_ptr<Texture>> specularMaps =
-            loadMaterialTextures(material, aiTextureType_SPECULAR, TextureType::TEX_SPECULAR);
-        if (!specularMaps.empty())
-        {
-            mat.textures.insert(mat.textures.end(), specularMaps.begin(), specularMaps.end());
-            mat.useSpecularMap = true;
-        }
+        before = pending.textures.size();
+        loadMaterialTextures(material, aiTextureType_SPECULAR, TextureType::TEX_SPECULAR, pending.textures);
+        mat.useSpecularMap = pending.textures.size() > before;
 
         // Optional: get base colors from material if no textures
         aiColor3D color(1.0f, 1.0f, 1.0f);
@@ -127,26 +351,31 @@ MeshEntry Model::processMesh(aiMesh* mesh, const aiScene* scene)
             mat.shininess = shininess;
     }
 
-    MeshEntry entry;
-    entry.mesh = std::make_shared<Mesh>(vertices, indices);
-    entry.material = std::make_shared<Material>(mat);
-    return entry;
+    MeshOptions options{ format, false, MODEL_LOD_LEVELS };
+    options.buildBvh = buildBvh;
+    if (mesh->mNumFaces >= MODEL_MESHLET_MIN_TRIANGLES)
+        options.meshlets = &pending.meshlets;
+    pending.data = Mesh::Prepare(std::move(vertices), std::move(indices), options);
+    if (loader->cooking)
+    {
+        std::vector<MeshCache::TextureRef> refs;
+        for (const PendingTexture& texture : pending.textures)
+            refs.push_back({ texture.path, texture.type });
+        loader->writer.Add(pending.data, pending.meshlets, pending.material, refs);
+    }
+
+    std::lock_guard<std::mutex> lock(loader->mutex);
+    loader->ready.push_back(std::move(pending));
 }
 
-std::vector<std::shared_ptr<Texture>> Model::loadMaterialTextures(aiMaterial* mat,
-	aiTextureType type, TextureType typeName)
+void Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType typeName,
+	std::vector<PendingTexture>& textures)
 {
-    std::vector<std::shared_ptr<Texture>> textures;
-    
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
 		aiString str;
 		mat->GetTexture(type, i, &str);
-		std::shared_ptr<Texture> texture;
 		std::string fileName = std::string(str.C_Str());
-		texture = ResourceManager::LoadTexture(
-					this->directory + '/' + fileName, typeName);
-		textures.push_back(texture);
+		textures.push_back(decodeTexture(this->directory + '/' + fileName, typeName));
 	}
-	return textures;
-}
\ No newline at end of file
+}
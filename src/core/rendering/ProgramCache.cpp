@@ -0,0 +1,161 @@
+#include "core/rendering/ProgramCache.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "core/rendering/GLCaps.h"
+
+unsigned ProgramCache::restored = 0;
+unsigned ProgramCache::saved = 0;
+
+namespace
+{
+    constexpr char MAGIC[4] = { 'P', 'P', 'R', 'G' };
+    constexpr uint32_t VERSION = 1;
+
+    struct ProgramHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+        uint32_t driverLength;  // the driver string follows the header, then the binary
+        uint32_t pad;
+    };
+
+    // FNV-1a, so keys do not depend on the standard library
+    uint64_t hashBytes(uint64_t hash, const std::string& bytes)
+    {
+        for (unsigned char c : bytes)
+            hash = (hash ^ c) * 1099511628211ull;
+        // a separator, so ("ab", "c") and ("a", "bc") differ
+        return (hash ^ 0xFFu) * 1099511628211ull;
+    }
+}
+
+bool ProgramCache::Enabled()
+{
+    return GLCaps::ProgramBinary();
+}
+
+const std::string& ProgramCache::driver()
+{
+    static const std::string name = [] {
+        auto text = [](GLenum name) {
+            const GLubyte* value = glGetString(name);
+            return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+        };
+        return text(GL_VENDOR) + " | " + text(GL_RENDERER) + " | " + text(GL_VERSION);
+    }();
+    return name;
+}
+
+uint64_t ProgramCache::MakeKey(const std::string& vertexCode, const std::string& fragmentCode)
+{
+    uint64_t hash = 14695981039346656037ull;
+    hash = hashBytes(hash, driver());
+    hash = hashBytes(hash, vertexCode);
+    return hashBytes(hash, fragmentCode);
+}
+
+std::string ProgramCache::cachePath(uint64_t key)
+{
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return std::string(CACHE_DIRECTORY) + "/" + name + ".bin";
+}
+
+GLuint ProgramCache::Load(uint64_t key)
+{
+    const std::string path = cachePath(key);
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return 0;
+    std::vector<char> bytes(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(bytes.data(), bytes.size()) || bytes.size() < sizeof(ProgramHeader)) return 0;
+
+    ProgramHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.key != key ||
+        uint64_t(header.driverLength) + header.binaryLength != bytes.size() - sizeof(ProgramHeader))
+        return 0;
+    // guards against key collisions between drivers
+    const char* driverName = bytes.data() + sizeof(ProgramHeader);
+    if (driver().compare(0, std::string::npos, driverName, header.driverLength) != 0) return 0;
+
+    GLuint program = glCreateProgram();
+    GLCaps::programBinary(program, header.binaryFormat, driverName + header.driverLength,
+        static_cast<GLsizei>(header.binaryLength));
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        // same driver strings, but the driver still wants a rebuild (an update, other settings)
+        std::cout << "ProgramCache: driver rejected " << path << ", compiling from source\n";
+        glDeleteProgram(program);
+        return 0;
+    }
+    ++restored;
+    return program;
+}
+
+void ProgramCache::PrepareForSave(GLuint program)
+{
+    if (Enabled())
+        GLCaps::programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool ProgramCache::Save(uint64_t key, GLuint program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return false;
+
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    GLCaps::getProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) return false;
+
+    ProgramHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.key = key;
+    header.binaryFormat = format;
+    header.binaryLength = static_cast<uint32_t>(written);
+    header.driverLength = static_cast<uint32_t>(driver().size());
+
+    const std::string path = cachePath(key);
+    std::error_code error;
+    std::filesystem::create_directories(CACHE_DIRECTORY, error);
+
+    // written under another name and renamed, so no one reads a half-written file
+    const std::string partial = path + ".part";
+    {
+        std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(driver().data(), driver().size());
+        out.write(binary.data(), written);
+        if (!out)
+        {
+            std::cerr << "ProgramCache: cannot write " << partial << "\n";
+            out.close();
+            std::filesystem::remove(partial, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(partial, path, error);
+    if (error)
+    {
+        std::cerr << "ProgramCache: cannot replace " << path << ": " << error.message() << "\n";
+        std::filesystem::remove(partial, error);
+        return false;
+    }
+    ++saved;
+    return true;
+}
@@ -1,25 +1,238 @@
 #include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
 #include "core/rendering/Renderer.h"
 #include "core/rendering/Model.h"
+#include "core/rendering/GLState.h"
 #include "core/ResourceManager.h"
+#include "core/LightManager.h"
+#include "core/JobSystem.h"
+
+// --------------------------------------------
+// Sort key layout (most significant first)
+//   63..60  pass
+//   59..48  shader program
+//   47..32  material (dense per-frame id)
+//   31..16  mesh (geometry pool handle)
+//   15..0   depth bucket (front-to-back)
+// --------------------------------------------
+static constexpr int KEY_PASS_SHIFT = 60;
+static constexpr int KEY_SHADER_SHIFT = 48;
+static constexpr int KEY_MATERIAL_SHIFT = 32;
+static constexpr int KEY_MESH_SHIFT = 16;
+static constexpr uint64_t KEY_SHADER_MASK = 0xFFFull << KEY_SHADER_SHIFT;
+
+static RenderPass passFromKey(uint64_t key)
+{
+    return static_cast<RenderPass>(key >> KEY_PASS_SHIFT);
+}
+
+// Runs shorter than this are drawn one by one
+static constexpr uint32_t MIN_INSTANCED_RUN = 2;
+
+// Meshlet culling: commands handed to a worker at a time
+static constexpr uint32_t MESHLET_CULL_GRAIN = 4;
+
+// Two materials that would produce identical draws (used to merge per-entity copies)
+static bool sameSurface(const Material& a, const Material& b)
+{
+    return a.textures == b.textures
+        && a.diffuseColor == b.diffuseColor
+        && a.specularColor == b.specularColor
+        && a.shininess == b.shininess
+        && a.useDiffuseMap == b.useDiffuseMap
+        && a.useSpecularMap == b.useSpecularMap
+        && a.outlineEnabled == b.outlineEnabled
+        && a.outlineColor == b.outlineColor;
+}
+
+// Inverse-transpose of the model's upper 3x3, computed once per object instead of per vertex.
+// Any Transform (rotation * scale) has orthogonal columns, so the inverse reduces to dividing
+// each column by its squared length; uniform scale is the common case of that.
+// Only sheared matrices pay for a real inverse.
+static glm::mat3 normalMatrix(const glm::mat4& model)
+{
+    glm::mat3 m(model);
+    float lx = glm::dot(m[0], m[0]);
+    float ly = glm::dot(m[1], m[1]);
+    float lz = glm::dot(m[2], m[2]);
+
+    const float eps = 1e-5f * glm::max(lx, glm::max(ly, lz));
+    if (lx > 0.0f && ly > 0.0f && lz > 0.0f
+        && glm::abs(glm::dot(m[0], m[1])) <= eps
+        && glm::abs(glm::dot(m[0], m[2])) <= eps
+        && glm::abs(glm::dot(m[1], m[2])) <= eps)
+    {
+        m[0] /= lx;
+        m[1] /= ly;
+        m[2] /= lz;
+        return m;
+    }
+    return glm::transpose(glm::inverse(m));
+}
+
+// Draws in one multi-draw group share the program's texture units
+static bool sameTextures(const Material& a, const Material& b)
+{
+    return a.textures == b.textures;
+}
+
+// ...and one VAO and index type
+static bool sameGeometryLayout(const Mesh& a, const Mesh& b)
+{
+    return a.VAO == b.VAO
+        && GeometryPool::Get(a.geometry).indexSize == GeometryPool::Get(b.geometry).indexSize;
+}
+
+bool Renderer::UsesMultiDraw() const
+{
+    return multiDrawEnabled && GLCaps::MultiDrawIndirect();
+}
 
 void Renderer::BeginScene(const glm::mat4& view, const glm::mat4& projection,
-    const glm::vec3& viewPos)
+    const glm::vec3& viewPos, float viewportHeight)
 {
-    glEnable(GL_STENCIL_TEST);
-    glEnable(GL_DEPTH_TEST);
+    GLState::SetStencilTest(true);
+    GLState::SetDepthTest(true);
     // Default stencil op: replace stencil on depth pass (we'll set func per pass below)
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    GLState::StencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
     // Clear color, depth and stencil at frame start to avoid stale values.
+    // (glClear honours the write masks, so make sure stencil is writable)
+    GLState::StencilMask(0xFF);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
     viewMatrix = view;
     projMatrix = projection;
     viewPosition = viewPos;
+
+    // camera data is constant for the frame: one upload, visible to every program
+    CameraBlock camera;
+    camera.view = view;
+    camera.projection = projection;
+    camera.viewPos = viewPos;
+    cameraBuffer.Write(&camera);
+
+    frustum.Extract(projection * view);
+
+    lodScale = projection[1][1] * viewportHeight * 0.5f;
+
+    // Recover clip planes from a perspective matrix to normalize depth buckets
+    if (projection[2][3] != 0.0f)
+    {
+        nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+        farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+    }
+
+    commands.clear();
+    sortItems.clear();
+    batches.clear();
+    instanceData.clear();
+    indirectCommands.clear();
+    materialIds.clear();
+    uniqueMaterials.clear();
+    objectBoxes.Clear();
+    cullStats = CullStats();
+}
+
+void Renderer::SetLights(LightManager& lightManager)
+{
+    lights = &lightManager;
 }
+
+uint16_t Renderer::materialId(const Material* mat)
+{
+    if (!mat) return 0;
+
+    auto it = materialIds.find(mat);
+    if (it != materialIds.end()) return it->second;
+
+    // entities often carry their own copy of the same material; give equal copies one id
+    uint16_t id = 0;
+    for (size_t i = 0; i < uniqueMaterials.size(); ++i)
+    {
+        if (sameSurface(*uniqueMaterials[i], *mat))
+        {
+            id = static_cast<uint16_t>(i + 1);
+            break;
+        }
+    }
+    if (id == 0)
+    {
+        uniqueMaterials.push_back(mat);
+        id = static_cast<uint16_t>(uniqueMaterials.size());
+    }
+    materialIds.emplace(mat, id);
+    return id;
+}
+
+uint64_t Renderer::makeKey(RenderPass pass, const Shader& shader, const Material* mat,
+    const Mesh& mesh, const glm::mat4& model)
+{
+    uint16_t matId = materialId(mat);
+
+    // view-space depth of the object origin, quantized into 16 bits
+    float depth = -(viewMatrix * model[3]).z;
+    float t = glm::clamp((depth - nearPlane) / (farPlane - nearPlane), 0.0f, 1.0f);
+    uint64_t depthBucket = static_cast<uint64_t>(t * 65535.0f);
+
+    return (static_cast<uint64_t>(pass) << KEY_PASS_SHIFT)
+        | (static_cast<uint64_t>(shader.ID & 0xFFF) << KEY_SHADER_SHIFT)
+        | (static_cast<uint64_t>(matId) << KEY_MATERIAL_SHIFT)
+        | (static_cast<uint64_t>(mesh.geometry & 0xFFFF) << KEY_MESH_SHIFT)
+        | depthBucket;
+}
+
+// Registers the world-space box of one submission; its commands share the result
+uint32_t Renderer::addObject(const Bounds& bounds, const glm::mat4& model)
+{
+    if (!bounds.valid) return UINT32_MAX;
+
+    glm::vec3 worldMin, worldMax;
+    bounds.Transform(model, worldMin, worldMax);
+    objectBoxes.Push(worldMin, worldMax);
+    return static_cast<uint32_t>(objectBoxes.Size() - 1);
+}
+
+// Picks the level of detail from the projected size of the submission's bounds;
+// the distance is measured to the nearest point of the bounding sphere
+const Mesh& Renderer::selectLod(const Mesh& mesh, const Bounds& bounds, const glm::mat4& model) const
+{
+    if (mesh.lods.empty() || lodMaxPixels <= 0.0f || !bounds.valid) return mesh;
+
+    const float scale = glm::sqrt(glm::max(glm::dot(model[0], model[0]),
+        glm::max(glm::dot(model[1], model[1]), glm::dot(model[2], model[2]))));
+    float pixelsPerUnit = lodScale * scale;
+
+    // perspective: size falls off with distance (orthographic: constant)
+    if (projMatrix[2][3] != 0.0f)
+    {
+        glm::vec3 center = glm::vec3(model * glm::vec4(bounds.center, 1.0f));
+        float distance = glm::length(center - viewPosition) - bounds.radius * scale;
+        pixelsPerUnit /= glm::max(distance, nearPlane);
+    }
+    return mesh.SelectLod(pixelsPerUnit, lodMaxPixels);
+}
+
+void Renderer::queue(RenderPass pass, const glm::mat4& model, const Mesh& mesh,
+    Shader* shader, const Material* mat, uint32_t object, const std::vector<Meshlet>* meshlets)
+{
+    RenderCommand cmd;
+    cmd.model = model;
+    cmd.mesh = &mesh;
+    cmd.shader = shader;
+    cmd.material = mat;
+    cmd.object = object;
+    if (meshletCullingEnabled && meshlets && !meshlets->empty())
+        cmd.meshlets = meshlets;
+
+    sortItems.push_back({ makeKey(pass, *shader, mat, mesh, model),
+        static_cast<uint32_t>(commands.size()) });
+    commands.push_back(cmd);
+}
+
 // --------------------------------------------
-// SubmitMesh  Draws a single mesh with material
+// SubmitMesh  Records a single mesh with material
 // --------------------------------------------
 void Renderer::SubmitMesh(const glm::mat4& model,
     const Mesh& mesh,
@@ -27,89 +240,523 @@ void Renderer::SubmitMesh(const glm::mat4& model,
 {
     if (!shader) return;
 
-    // --- NON-OUTLINE: simple draw (ensure stencil not written) ---
+    const Mesh& level = selectLod(mesh, mesh.bounds, model);
+
     if (!mat->outlineEnabled)
     {
-        // Prevent writing to stencil for regular objects
-        glStencilMask(0x00);        // disable writing to stencil
-      
-        shader->use();
-        shader->setMat4("model", model);
-        shader->setMat4("view", viewMatrix);
-        shader->setMat4("projection", projMatrix);
-        shader->setVec3("viewPos", viewPosition);
-
-        mesh.Draw(*shader, *mat);
+        queue(RenderPass::Opaque, model, level, shader.get(), mat.get(),
+            addObject(mesh.bounds, model));
         return;
     }
 
-    // --- OUTLINE: two-pass technique ---
+    // Slightly scale the model for rim size (smaller factor avoids self-intersection)
+    const float outlineScale = 1.04f; // tweak between 1.01 - 1.1 depending on mesh
+    const glm::mat4 rimModel = glm::scale(model, glm::vec3(outlineScale));
+
+    // --- OUTLINE: object writes stencil, rim is drawn later where stencil != 1 ---
+    // (one volume for both, sized to the rim)
+    uint32_t object = addObject(mesh.bounds, rimModel);
+    queue(RenderPass::Outlined, model, level, shader.get(), mat.get(), object);
 
-    // 1) Render object and write stencil = 1 where fragments pass depth.
-    glStencilFunc(GL_ALWAYS, 1, 0xFF); // stencil value becomes 1 where object draws
-    glStencilMask(0xFF);               // allow writing to stencil buffer
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    if (!outlineShader)
+        outlineShader = ResourceManager::LoadShader("outline",
+            "shaders/singleColor.vs", "shaders/singleColor.fs");
+    if (outlineShader)
+        queue(RenderPass::Outline, rimModel, level, outlineShader.get(), mat.get(), object);
+}
 
-    // Ensure normal rendering state
-    glEnable(GL_DEPTH_TEST);
-  
-    shader->use();
-    shader->setMat4("model", model);
-    shader->setMat4("view", viewMatrix);
-    shader->setMat4("projection", projMatrix);
-    shader->setVec3("viewPos", viewPosition);
+// --------------------------------------------
+// SubmitModel  Records every sub-mesh of a model (with per-mesh materials)
+// --------------------------------------------
+void Renderer::SubmitModel(const glm::mat4& model,
+    Model& modelObj,
+    const std::shared_ptr<Shader>& shader)
+{
+    if (!shader) return;
 
-    // Draw the actual object (this writes stencil=1 where fragments drew)
-    mesh.Draw(*shader, *mat);
+    // the whole model is culled as one volume
+    uint32_t object = addObject(modelObj.GetBounds(), model);
+    for (const MeshEntry& entry : modelObj.GetMeshes())
+    {
+        // meshlets describe the full-detail index list only
+        const Mesh& level = selectLod(*entry.mesh, modelObj.GetBounds(), model);
+        queue(RenderPass::Opaque, model, level, shader.get(), entry.material.get(), object,
+            &level == entry.mesh.get() ? &entry.meshlets : nullptr);
+    }
+}
 
-    // 2) Outline pass: draw where stencil != 1.
+void Renderer::EndScene()
+{
+    cull();
+    cullMeshlets();
+    specialize();
+    std::sort(sortItems.begin(), sortItems.end(),
+        [](const SortItem& a, const SortItem& b) { return a.key < b.key; });
+    buildBatches();
+    uploadInstances();
+    uploadMultiDraw();
+    // one shared buffer for every lit program; only lights edited since last frame are re-sent
+    if (lights) lights->Upload();
+    flush();
 
-    // Now configure stencil test for outline; don't write to stencil
-    glStencilFunc(GL_NOTEQUAL, 1, 0xFF); // draw only where stencil != 1
-    glStencilMask(0x00);                 // disable stencil writes for outline
-  
-    // Slightly scale the model for rim size (smaller factor avoids self-intersection)
-    const float outlineScale = 1.04f; // tweak between 1.01 - 1.1 depending on mesh
-    glm::mat4 outlineModel = glm::scale(model, glm::vec3(outlineScale));
+    // the camera slot written in BeginScene and this frame's streams are now
+    // referenced by queued GPU work
+    cameraBuffer.Fence();
+    instanceStream.EndFrame();
+    indirectStream.EndFrame();
+    materialStream.EndFrame();
+}
 
-    std::shared_ptr<Shader> outlineShader = ResourceManager::LoadShader("outline",
-        "shaders/singleColor.vs", "shaders/singleColor.fs");
-    if (outlineShader)
+// --------------------------------------------
+// cull  Tests every submission against the frustum at once and drops
+// the commands of invisible ones before sorting
+// --------------------------------------------
+void Renderer::cull()
+{
+    frustum.CullBoxes(objectBoxes, objectVisible);
+
+    cullStats.tested = static_cast<uint32_t>(objectBoxes.Size());
+    cullStats.culled = 0;
+    for (uint8_t v : objectVisible)
+        cullStats.culled += v ? 0 : 1;
+    if (cullStats.culled == 0) return;
+
+    std::erase_if(sortItems, [this](const SortItem& item) {
+        uint32_t object = commands[item.index].object;
+        return object != UINT32_MAX && !objectVisible[object];
+    });
+}
+
+// --------------------------------------------
+// cullMeshlets - Tests the clusters of every visible command that has them,
+// spread over the job system; each command keeps the index ranges of its
+// surviving clusters (neighbours merged) and is dropped if none survive
+// --------------------------------------------
+void Renderer::cullMeshlets()
+{
+    meshletCommands.clear();
+    meshletRanges.clear();
+    for (const SortItem& item : sortItems)
+        if (commands[item.index].meshlets)
+            meshletCommands.push_back(item.index);
+    if (meshletCommands.empty()) return;
+
+    const uint32_t count = static_cast<uint32_t>(meshletCommands.size());
+    if (meshletScratch.size() < count)
+        meshletScratch.resize(count);
+
+    std::atomic<uint32_t> culled{ 0 };
+    JobSystem::ParallelFor(count, MESHLET_CULL_GRAIN, [&](uint32_t begin, uint32_t end) {
+        uint32_t local = 0;
+        for (uint32_t i = begin; i < end; ++i)
+            local += cullMeshletsOf(commands[meshletCommands[i]], meshletScratch[i]);
+        culled.fetch_add(local, std::memory_order_relaxed);
+    });
+
+    bool anyEmpty = false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        RenderCommand& cmd = commands[meshletCommands[i]];
+        const std::vector<IndexRange>& ranges = meshletScratch[i];
+        cmd.firstRange = static_cast<uint32_t>(meshletRanges.size());
+        cmd.rangeCount = static_cast<uint32_t>(ranges.size());
+        meshletRanges.insert(meshletRanges.end(), ranges.begin(), ranges.end());
+        cullStats.meshletsTested += static_cast<uint32_t>(cmd.meshlets->size());
+        anyEmpty |= ranges.empty();
+    }
+    cullStats.meshletsCulled = culled.load();
+
+    if (anyEmpty)
+        std::erase_if(sortItems, [this](const SortItem& item) {
+            const RenderCommand& cmd = commands[item.index];
+            return cmd.meshlets && cmd.rangeCount == 0;
+        });
+}
+
+// Runs on worker threads: reads only the command and this frame's camera.
+// Returns how many clusters were rejected.
+uint32_t Renderer::cullMeshletsOf(const RenderCommand& cmd, std::vector<IndexRange>& ranges) const
+{
+    ranges.clear();
+
+    const glm::mat3 basis(cmd.model);
+    const float sx = glm::dot(basis[0], basis[0]);
+    const float sy = glm::dot(basis[1], basis[1]);
+    const float sz = glm::dot(basis[2], basis[2]);
+    const float maxScale2 = glm::max(sx, glm::max(sy, sz));
+    const float scale = glm::sqrt(maxScale2);
+    // cones only survive uniform scale (normals would need the inverse-transpose otherwise)
+    const bool coneTest = meshletConeCullingEnabled
+        && glm::max(glm::abs(sx - sy), glm::abs(sx - sz)) <= 1e-3f * maxScale2;
+    const bool perspective = projMatrix[2][3] != 0.0f;
+    // orthographic: every view ray points down -z of the camera
+    const glm::vec3 viewForward = -glm::vec3(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2]);
+
+    uint32_t culled = 0;
+    for (const Meshlet& m : *cmd.meshlets)
     {
-        outlineShader->use();
-        outlineShader->setMat4("model", outlineModel);
-        outlineShader->setMat4("view", viewMatrix);
-        outlineShader->setMat4("projection", projMatrix);
-        outlineShader->setVec3("color", mat->outlineColor);
+        const glm::vec3 center = glm::vec3(cmd.model * glm::vec4(m.center, 1.0f));
+        const float radius = m.radius * scale;
+
+        bool visible = frustum.IntersectsSphere(center, radius);
+        if (visible && coneTest && m.coneCutoff < 1.0f)
+        {
+            const glm::vec3 axis = basis * m.coneAxis / scale;
+            if (perspective)
+            {
+                const glm::vec3 toCenter = center - viewPosition;
+                visible = glm::dot(toCenter, axis) < m.coneCutoff * glm::length(toCenter) + radius;
+            }
+            else
+                visible = glm::dot(viewForward, axis) < m.coneCutoff;
+        }
 
-        // Draw raw geometry for the rim (no textures/material)
-        mesh.DrawSimple();
+        if (!visible)
+        {
+            ++culled;
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == m.firstIndex)
+            ranges.back().count += m.indexCount;
+        else
+            ranges.push_back({ m.firstIndex, m.indexCount });
     }
+    return culled;
+}
 
-    // Restore stencil defaults for subsequent draws
-    glStencilMask(0xFF);
-    glStencilFunc(GL_ALWAYS, 0, 0xFF);
+// --------------------------------------------
+// specialize  Swaps each lit command's program for the variant compiled for
+// its material and this frame's light counts, and patches the program bits of
+// its sort key (commands are keyed with the base program when queued)
+// --------------------------------------------
+void Renderer::specialize()
+{
+    const int numPoint = lights ? lights->PointLightCount() : 0;
+    const int numSpot = lights ? lights->SpotLightCount() : 0;
+
+    for (SortItem& item : sortItems)
+    {
+        if (passFromKey(item.key) == RenderPass::Outline)
+            continue;
+
+        RenderCommand& cmd = commands[item.index];
+        Shader* variant = shaderVariant(cmd.shader, cmd.material, numPoint, numSpot);
+        if (!variant) continue;
+
+        cmd.shader = variant;
+        item.key = (item.key & ~KEY_SHADER_MASK)
+            | (static_cast<uint64_t>(variant->ID & 0xFFF) << KEY_SHADER_SHIFT);
+    }
+}
+
+Shader* Renderer::shaderVariant(Shader* base, const Material* mat, int numPoint, int numSpot)
+{
+    const bool diffuseMap = mat && mat->useDiffuseMap;
+    const bool specularMap = mat && mat->useSpecularMap;
+    const uint32_t features = (diffuseMap ? 1u : 0u) | (specularMap ? 2u : 0u)
+        | (static_cast<uint32_t>(numPoint) << 2) | (static_cast<uint32_t>(numSpot) << 8);
+
+    auto key = std::make_pair(static_cast<const Shader*>(base), features);
+    auto it = shaderVariants.find(key);
+    if (it == shaderVariants.end())
+    {
+        std::vector<std::string> defines = base->GetDefines();
+        defines.push_back("SPECIALIZED");
+        defines.push_back("NUM_POINT=" + std::to_string(numPoint));
+        defines.push_back("NUM_SPOT=" + std::to_string(numSpot));
+        if (diffuseMap) defines.push_back("DIFFUSE_MAP");
+        if (specularMap) defines.push_back("SPECULAR_MAP");
+        it = shaderVariants.emplace(key, ResourceManager::LoadShaderVariant(*base, defines)).first;
+    }
+    return it->second.get();
 }
-  
+
 // --------------------------------------------
-// SubmitModel  Draws an entire model (with per-mesh materials)
+// buildBatches  Splits the sorted list into runs of identical draws
+// (same pass, program, material and mesh) and packs instance data for them
 // --------------------------------------------
-void Renderer::SubmitModel(const glm::mat4& model,
-    Model& modelObj,
-    const std::shared_ptr<Shader>& shader)
+void Renderer::buildBatches()
 {
-    if (!shader) return;
+    const bool multiDraw = UsesMultiDraw();
+    const uint32_t count = static_cast<uint32_t>(sortItems.size());
+    for (uint32_t first = 0; first < count; )
+    {
+        const uint64_t group = sortItems[first].key >> KEY_MESH_SHIFT;
+        const Mesh* mesh = commands[sortItems[first].index].mesh;
+        // commands drawn as meshlet ranges never share a run with whole-mesh draws
+        const bool ranged = commands[sortItems[first].index].meshlets != nullptr;
+
+        uint32_t last = first + 1;
+        while (last < count
+            && (sortItems[last].key >> KEY_MESH_SHIFT) == group
+            && commands[sortItems[last].index].mesh == mesh
+            && (commands[sortItems[last].index].meshlets != nullptr) == ranged)
+            ++last;
+
+        const RenderCommand& head = commands[sortItems[first].index];
+        DrawBatch batch;
+        batch.first = first;
+        batch.count = last - first;
 
-    shader->use();
-    shader->setMat4("model", model);
-    shader->setMat4("view", viewMatrix);
-    shader->setMat4("projection", projMatrix);
-    shader->setVec3("viewPos", viewPosition);
-    
-    modelObj.Draw(*shader);
+        // multi-draw takes every indexed lit batch, even single draws; the rest
+        // (outline rims, non-indexed meshes, GL 3.3) falls back to instancing runs
+        if (multiDraw && passFromKey(sortItems[first].key) != RenderPass::Outline
+            && head.material && head.mesh->geometry != GeometryPool::INVALID && head.mesh->indexCount > 0)
+            batch.instancedShader = multiDrawVariant(head.shader);
+        batch.multiDraw = batch.instancedShader != nullptr;
+        if (!batch.multiDraw && !ranged && batch.count >= MIN_INSTANCED_RUN)
+            batch.instancedShader = instancedVariant(head.shader);
+
+        if (batch.instancedShader)
+        {
+            // the whole run shares one material (it is part of the group key)
+            uint32_t matId = static_cast<uint32_t>((sortItems[first].key >> KEY_MATERIAL_SHIFT) & 0xFFFF);
+            uint32_t material = matId ? matId - 1 : 0;
+
+            batch.firstInstance = static_cast<uint32_t>(instanceData.size());
+            for (uint32_t i = first; i < last; ++i)
+            {
+                const glm::mat4& model = commands[sortItems[i].index].model;
+                instanceData.push_back({ mesh->DecodeModel(model), normalMatrix(model), material });
+            }
+        }
+
+        if (batch.multiDraw)
+        {
+            // baseInstance makes each draw read its own slice of the instance buffer
+            const GeometryRange& range = GeometryPool::Get(head.mesh->geometry);
+            batch.command = static_cast<uint32_t>(indirectCommands.size());
+            if (!ranged)
+            {
+                indirectCommands.push_back({ range.indexCount, batch.count, range.firstIndex,
+                    static_cast<GLint>(range.baseVertex), batch.firstInstance });
+            }
+            else
+            {
+                // clusters differ per command: one draw per surviving range, each
+                // reading its command's instance
+                for (uint32_t i = first; i < last; ++i)
+                {
+                    const RenderCommand& cmd = commands[sortItems[i].index];
+                    for (uint32_t r = cmd.firstRange; r < cmd.firstRange + cmd.rangeCount; ++r)
+                        indirectCommands.push_back({ meshletRanges[r].count, 1,
+                            range.firstIndex + meshletRanges[r].first,
+                            static_cast<GLint>(range.baseVertex), batch.firstInstance + (i - first) });
+                }
+                batch.commandCount = static_cast<uint32_t>(indirectCommands.size()) - batch.command;
+            }
+        }
+
+        batches.push_back(batch);
+        first = last;
+    }
 }
 
-void Renderer::EndScene()
+void Renderer::uploadInstances()
+{
+    if (instanceData.empty()) return;
+
+    // the frame is sized up front, so the write always fits
+    const size_t bytes = instanceData.size() * sizeof(InstanceData);
+    instanceStream.BeginFrame(bytes);
+    instanceOffset = instanceStream.Write(instanceData.data(), bytes);
+}
+
+// Indirect commands, plus every material of the frame indexed by its dense id - 1
+void Renderer::uploadMultiDraw()
+{
+    if (indirectCommands.empty()) return;
+
+    const size_t commandBytes = indirectCommands.size() * sizeof(DrawElementsIndirectCommand);
+    indirectStream.BeginFrame(commandBytes);
+    indirectOffset = indirectStream.Write(indirectCommands.data(), commandBytes);
+
+    gpuMaterials.clear();
+    for (const Material* mat : uniqueMaterials)
+        gpuMaterials.push_back({ glm::vec4(mat->diffuseColor, 1.0f),
+            glm::vec4(mat->specularColor, mat->shininess) });
+
+    static GLint storageAlignment = 0;
+    if (!storageAlignment)
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+
+    const size_t materialBytes = gpuMaterials.size() * sizeof(GPUMaterial);
+    materialStream.BeginFrame(materialBytes + storageAlignment);
+    size_t offset = materialStream.Write(gpuMaterials.data(), materialBytes, storageAlignment);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, StorageBinding::Materials, materialStream.Buffer(),
+        offset, materialBytes);
+}
+
+// Points attribute locations 3..10 of the mesh VAO at this batch's instance range
+void Renderer::bindInstanceAttributes(const Mesh& mesh, uint32_t firstInstance)
+{
+    GLState::BindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceStream.Buffer());
+
+    const GLsizei stride = sizeof(InstanceData);
+    const size_t base = instanceOffset + firstInstance * sizeof(InstanceData);
+
+    // mat4 model -> 4 x vec4
+    for (int col = 0; col < 4; ++col)
+    {
+        GLuint loc = 3 + col;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, stride,
+            (void*)(base + offsetof(InstanceData, model) + col * sizeof(glm::vec4)));
+        glVertexAttribDivisor(loc, 1);
+    }
+    // mat3 normal matrix -> 3 x vec3
+    for (int col = 0; col < 3; ++col)
+    {
+        GLuint loc = 7 + col;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, stride,
+            (void*)(base + offsetof(InstanceData, normalMatrix) + col * sizeof(glm::vec3)));
+        glVertexAttribDivisor(loc, 1);
+    }
+    // material index (integer attribute, read by multi-draw programs only)
+    glEnableVertexAttribArray(10);
+    glVertexAttribIPointer(10, 1, GL_UNSIGNED_INT, stride, (void*)(base + offsetof(InstanceData, material)));
+    glVertexAttribDivisor(10, 1);
+}
+
+// Instanced program compiled as GLSL 4.30 with per-draw materials from the storage buffer.
+// Only specialized programs qualify: they need no per-material uniforms besides textures.
+Shader* Renderer::multiDrawVariant(Shader* shader)
+{
+    auto it = multiDrawShaders.find(shader);
+    if (it == multiDrawShaders.end())
+    {
+        std::shared_ptr<Shader> variant;
+        if (shader->HasDefine("SPECIALIZED"))
+            variant = ResourceManager::LoadInstancedVariant(*shader, { "MULTI_DRAW", "GLSL_VERSION=430" });
+        it = multiDrawShaders.emplace(shader, variant).first;
+    }
+    return it->second.get();
+}
+
+Shader* Renderer::instancedVariant(Shader* shader)
+{
+    auto it = instancedShaders.find(shader);
+    if (it == instancedShaders.end())
+        it = instancedShaders.emplace(shader, ResourceManager::LoadInstancedVariant(*shader)).first;
+    return it->second.get();
+}
+
+// --------------------------------------------
+// flush  Issues the batches, changing state only between groups
+// --------------------------------------------
+void Renderer::flush()
 {
-    // Future batching or post effects
-}
\ No newline at end of file
+    const Shader* currentShader = nullptr;
+    const Material* currentMaterial = nullptr;
+    bool passStarted[3] = { false, false, false };
+
+    for (size_t b = 0; b < batches.size(); ++b)
+    {
+        const DrawBatch& batch = batches[b];
+        const RenderCommand& cmd = commands[sortItems[batch.first].index];
+        RenderPass pass = passFromKey(sortItems[batch.first].key);
+
+        int passIndex = static_cast<int>(pass);
+        if (!passStarted[passIndex])
+        {
+            passStarted[passIndex] = true;
+            switch (pass)
+            {
+            case RenderPass::Opaque:
+                GLState::StencilMask(0x00);               // regular objects never write stencil
+                break;
+            case RenderPass::Outlined:
+                GLState::StencilFunc(GL_ALWAYS, 1, 0xFF); // stencil value becomes 1 where object draws
+                GLState::StencilMask(0xFF);
+                GLState::StencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+                break;
+            case RenderPass::Outline:
+                GLState::StencilFunc(GL_NOTEQUAL, 1, 0xFF); // draw only where stencil != 1
+                GLState::StencilMask(0x00);
+                break;
+            }
+        }
+
+        Shader* shader = batch.instancedShader ? batch.instancedShader : cmd.shader;
+        if (shader != currentShader)
+        {
+            shader->use();
+            currentShader = shader;
+            currentMaterial = nullptr;
+        }
+
+        if (batch.multiDraw)
+        {
+            // following batches of the same pass, program, textures and vertex/index layout become one call;
+            // their material values come from the storage buffer
+            size_t end = b + 1;
+            while (end < batches.size() && batches[end].multiDraw
+                && batches[end].instancedShader == batch.instancedShader
+                && passFromKey(sortItems[batches[end].first].key) == pass
+                && sameTextures(*commands[sortItems[batches[end].first].index].material, *cmd.material)
+                && sameGeometryLayout(*commands[sortItems[batches[end].first].index].mesh, *cmd.mesh))
+                ++end;
+
+            if (cmd.material != currentMaterial)
+            {
+                Mesh::BindMaterialTextures(*shader, *cmd.material);
+                currentMaterial = cmd.material;
+            }
+            // merged batches own consecutive indirect commands
+            uint32_t drawCount = 0;
+            for (size_t m = b; m < end; ++m)
+                drawCount += batches[m].commandCount;
+
+            bindInstanceAttributes(*cmd.mesh, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectStream.Buffer());
+            GLCaps::multiDrawIndirect(GL_TRIANGLES, GeometryPool::Get(cmd.mesh->geometry).IndexType(),
+                (void*)(indirectOffset + batch.command * sizeof(DrawElementsIndirectCommand)),
+                static_cast<GLsizei>(drawCount), 0);
+
+            b = end - 1;
+            continue;
+        }
+
+        if (cmd.material != currentMaterial)
+        {
+            if (pass == RenderPass::Outline)
+                shader->setVec3("color", cmd.material->outlineColor);
+            else
+                Mesh::ApplyMaterial(*shader, *cmd.material);
+            currentMaterial = cmd.material;
+        }
+
+        if (batch.instancedShader)
+        {
+            bindInstanceAttributes(*cmd.mesh, batch.firstInstance);
+            cmd.mesh->DrawInstanced(static_cast<int>(batch.count));
+            continue;
+        }
+
+        for (uint32_t i = batch.first; i < batch.first + batch.count; ++i)
+        {
+            const RenderCommand& single = commands[sortItems[i].index];
+            if (single.material != currentMaterial)
+            {
+                if (pass == RenderPass::Outline)
+                    shader->setVec3("color", single.material->outlineColor);
+                else
+                    Mesh::ApplyMaterial(*shader, *single.material);
+                currentMaterial = single.material;
+            }
+            shader->setMat4("model", single.mesh->DecodeModel(single.model));
+            if (pass != RenderPass::Outline)
+                shader->setMat3("normalMatrix", normalMatrix(single.model));
+            if (single.meshlets)
+                single.mesh->DrawRanges(&meshletRanges[single.firstRange], single.rangeCount);
+            else
+                single.mesh->DrawSimple();
+        }
+    }
+
+    // Restore stencil defaults for subsequent draws
+    GLState::StencilMask(0xFF);
+    GLState::StencilFunc(GL_ALWAYS, 0, 0xFF);
+}
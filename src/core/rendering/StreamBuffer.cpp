@@ -0,0 +1,131 @@
+#include "core/rendering/StreamBuffer.h"
+#include "core/rendering/GLCaps.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// regions start on this boundary (covers every buffer offset alignment in practice)
+static constexpr size_t REGION_ALIGNMENT = 256;
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+StreamBuffer::StreamBuffer(size_t frameBytes, int frameCount)
+    : frameBytes(alignUp(std::max<size_t>(frameBytes, 1), REGION_ALIGNMENT)),
+    frameCount(std::clamp(frameCount, 1, MAX_FRAMES))
+{
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    release();
+}
+
+void StreamBuffer::create(size_t bytes)
+{
+    frameBytes = alignUp(bytes, REGION_ALIGNMENT);
+    region = 0;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (!GLCaps::BufferStorage()) return;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const size_t total = frameBytes * frameCount;
+    GLCaps::bufferStorage(GL_COPY_WRITE_BUFFER, total, nullptr, flags);
+    mapped = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags));
+    if (!mapped)
+    {
+        // immutable storage cannot be re-specified; start over with a plain buffer
+        std::cerr << "StreamBuffer: persistent mapping failed, orphaning instead\n";
+        glDeleteBuffers(1, &buffer);
+        glGenBuffers(1, &buffer);
+    }
+}
+
+void StreamBuffer::release()
+{
+    for (GLsync& fence : fences)
+        if (fence) { glDeleteSync(fence); fence = nullptr; }
+    if (mapped)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        mapped = nullptr;
+    }
+    // the driver keeps the storage alive for draws still in flight
+    if (buffer) glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void StreamBuffer::BeginFrame(size_t bytes)
+{
+    peak = std::max(peak, bytes);
+
+    if (!buffer || peak > frameBytes)
+    {
+        size_t size = frameBytes;
+        while (size < peak) size *= 2;
+#ifdef PYRE_VERBOSE
+        if (buffer)
+            std::cout << "StreamBuffer: growing to " << size / 1024 << " KB per frame\n";
+#endif
+        release();
+        create(size);
+    }
+    else if (mapped)
+        region = (region + 1) % frameCount;
+
+    if (mapped)
+    {
+        // a region written frameCount frames ago has practically always been consumed
+        GLsync& fence = fences[region];
+        if (fence)
+        {
+            GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            while (result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(fence, 0, 1000000);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        regionStart = region * frameBytes;
+    }
+    else
+    {
+        // orphan: the GPU keeps last frame's storage, this frame gets a fresh one
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, frameBytes, nullptr, GL_STREAM_DRAW);
+        regionStart = 0;
+    }
+    head = regionStart;
+}
+
+size_t StreamBuffer::Write(const void* data, size_t bytes, size_t alignment)
+{
+    const size_t offset = alignUp(head, std::max<size_t>(alignment, 1));
+    if (!buffer || offset + bytes > regionStart + frameBytes)
+    {
+        // remembered so the next frame has room for it
+        peak = std::max(peak, offset - regionStart + bytes);
+        return FULL;
+    }
+
+    if (mapped)
+        std::memcpy(mapped + offset, data, bytes);
+    else
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+    }
+    head = offset + bytes;
+    return offset;
+}
+
+void StreamBuffer::EndFrame()
+{
+    if (!mapped) return;
+    if (fences[region]) glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
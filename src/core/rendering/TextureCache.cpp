@@ -0,0 +1,272 @@
+#include "core/rendering/TextureCache.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include "core/rendering/GLCaps.h"
+#include "core/rendering/TextureCompressor.h"
+
+namespace
+{
+    constexpr unsigned char IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    constexpr uint32_t ENDIANNESS = 0x04030201;
+    constexpr const char* ORIENTATION_KEY = "KTXorientation";
+    constexpr const char* ORIENTATION = "S=r,T=u";
+    constexpr const char* SOURCE_KEY = "PyreSource";
+    constexpr uint32_t MAX_LEVELS = 32;
+
+    struct KtxHeader
+    {
+        unsigned char identifier[12];
+        uint32_t endianness;
+        uint32_t glType;                // 0 for compressed data
+        uint32_t glTypeSize;
+        uint32_t glFormat;              // 0 for compressed data
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+    static_assert(sizeof(KtxHeader) == 64, "KTX header is 64 bytes");
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint32_t readU32(const std::vector<unsigned char>& bytes, size_t offset)
+    {
+        uint32_t value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(value));
+        return value;
+    }
+
+    void appendKeyValue(std::string& block, const std::string& key, const std::string& value)
+    {
+        const uint32_t size = static_cast<uint32_t>(key.size() + 1 + value.size() + 1);
+        block.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        block.append(key).push_back('\0');
+        block.append(value).push_back('\0');
+        block.resize(alignUp(block.size(), 4), '\0');
+    }
+
+    // Value of key in the key/value block; false if it is missing or malformed
+    bool findValue(const std::vector<unsigned char>& bytes, size_t offset, size_t size,
+        const std::string& key, std::string& value)
+    {
+        const size_t end = offset + size;
+        while (offset + 4 <= end)
+        {
+            const uint32_t length = readU32(bytes, offset);
+            offset += 4;
+            if (length > end - offset) return false;
+
+            // "key\0value\0"
+            const char* entry = reinterpret_cast<const char*>(bytes.data() + offset);
+            const char* keyEnd = static_cast<const char*>(std::memchr(entry, '\0', length));
+            if (keyEnd && key.compare(0, std::string::npos, entry, keyEnd - entry) == 0)
+            {
+                const char* text = keyEnd + 1;
+                const char* textEnd = static_cast<const char*>(std::memchr(text, '\0', entry + length - text));
+                value.assign(text, textEnd ? textEnd : entry + length);
+                return true;
+            }
+            offset += alignUp(length, 4);
+        }
+        return false;
+    }
+
+    bool formatOf(uint32_t internalFormat, BlockFormat& format)
+    {
+        for (BlockFormat f : { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5 })
+            if (TextureCache::InternalFormat(f) == internalFormat)
+            {
+                format = f;
+                return true;
+            }
+        return false;
+    }
+
+    int channelsOf(BlockFormat format)
+    {
+        switch (format)
+        {
+        case BlockFormat::BC1: return 3;
+        case BlockFormat::BC3: return 4;
+        case BlockFormat::BC4: return 1;
+        case BlockFormat::BC5: return 2;
+        }
+        return 0;
+    }
+}
+
+std::string TextureCache::CachePath(const std::string& sourcePath)
+{
+    return sourcePath + ".ktx";
+}
+
+std::string TextureCache::sourceStamp(const std::string& sourcePath)
+{
+    std::error_code error;
+    const auto size = std::filesystem::file_size(sourcePath, error);
+    if (error) return {};
+    const auto time = std::filesystem::last_write_time(sourcePath, error);
+    if (error) return {};
+
+    return std::to_string(static_cast<uint64_t>(size)) + " " +
+        std::to_string(static_cast<int64_t>(time.time_since_epoch().count())) + " " +
+        std::to_string(VERSION);
+}
+
+GLenum TextureCache::InternalFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+    case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+    }
+    return 0;
+}
+
+GLenum TextureCache::BaseFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1: return GL_RGB;
+    case BlockFormat::BC3: return GL_RGBA;
+    case BlockFormat::BC4: return GL_RED;
+    case BlockFormat::BC5: return GL_RG;
+    }
+    return 0;
+}
+
+bool TextureCache::Load(const std::string& sourcePath, CompressedImage& image)
+{
+    const std::string stamp = sourceStamp(sourcePath);
+    if (stamp.empty()) return false;
+
+    const std::string path = CachePath(sourcePath);
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    std::vector<unsigned char> bytes(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) return false;
+    if (bytes.size() < sizeof(KtxHeader)) return false;
+
+    KtxHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 || header.endianness != ENDIANNESS)
+        return false;
+    if (header.bytesOfKeyValueData > bytes.size() - sizeof(KtxHeader)) return false;
+
+    // a file from another version of the source, or of the encoder, is rewritten
+    std::string recorded;
+    if (!findValue(bytes, sizeof(KtxHeader), header.bytesOfKeyValueData, SOURCE_KEY, recorded) ||
+        recorded != stamp)
+        return false;
+
+    CompressedImage result;
+    if (!formatOf(header.glInternalFormat, result.format) || header.glType != 0 ||
+        header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 ||
+        header.numberOfArrayElements != 0 || header.numberOfFaces != 1 ||
+        header.numberOfMipmapLevels == 0 || header.numberOfMipmapLevels > MAX_LEVELS)
+    {
+        std::cerr << "TextureCache: ignoring unsupported " << path << "\n";
+        return false;
+    }
+    result.channels = channelsOf(result.format);
+
+    // the levels stay where they are in the file's bytes
+    size_t offset = sizeof(KtxHeader) + header.bytesOfKeyValueData;
+    for (uint32_t i = 0; i < header.numberOfMipmapLevels; ++i)
+    {
+        CompressedImage::Level level;
+        level.width = std::max(1, static_cast<int>(header.pixelWidth >> i));
+        level.height = std::max(1, static_cast<int>(header.pixelHeight >> i));
+        level.size = TextureCompressor::EncodedSize(result.format, level.width, level.height);
+        if (offset + 4 > bytes.size() || readU32(bytes, offset) != level.size ||
+            level.size > bytes.size() - offset - 4)
+        {
+            std::cerr << "TextureCache: ignoring damaged " << path << "\n";
+            return false;
+        }
+        level.offset = offset + 4;
+        result.levels.push_back(level);
+        offset = alignUp(level.offset + level.size, 4);
+    }
+
+    result.data = std::move(bytes);
+    image = std::move(result);
+    return true;
+}
+
+bool TextureCache::Save(const std::string& sourcePath, const CompressedImage& image)
+{
+    const std::string stamp = sourceStamp(sourcePath);
+    if (stamp.empty() || !image) return false;
+
+    std::string keyValues;
+    appendKeyValue(keyValues, ORIENTATION_KEY, ORIENTATION);
+    appendKeyValue(keyValues, SOURCE_KEY, stamp);
+
+    KtxHeader header{};
+    std::memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+    header.endianness = ENDIANNESS;
+    header.glTypeSize = 1;
+    header.glInternalFormat = InternalFormat(image.format);
+    header.glBaseInternalFormat = BaseFormat(image.format);
+    header.pixelWidth = static_cast<uint32_t>(image.levels[0].width);
+    header.pixelHeight = static_cast<uint32_t>(image.levels[0].height);
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = static_cast<uint32_t>(image.levels.size());
+    header.bytesOfKeyValueData = static_cast<uint32_t>(keyValues.size());
+
+    const std::string path = CachePath(sourcePath);
+    std::error_code error;
+
+    // written under another name and renamed, so no one reads a half-written file
+    const std::string partial = path + ".part";
+    size_t written = sizeof(header) + keyValues.size();
+    {
+        std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+        const char zeros[4] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(keyValues.data(), keyValues.size());
+        for (size_t i = 0; i < image.levels.size(); ++i)
+        {
+            const uint32_t size = static_cast<uint32_t>(image.levels[i].size);
+            out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            out.write(reinterpret_cast<const char*>(image.LevelData(i)), size);
+            out.write(zeros, alignUp(size, 4) - size);
+            written += sizeof(size) + alignUp(size, 4);
+        }
+        if (!out)
+        {
+            std::cerr << "TextureCache: cannot write " << partial << "\n";
+            out.close();
+            std::filesystem::remove(partial, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(partial, path, error);
+    if (error)
+    {
+        std::cerr << "TextureCache: cannot replace " << path << ": " << error.message() << "\n";
+        std::filesystem::remove(partial, error);
+        return false;
+    }
+#ifdef PYRE_VERBOSE
+    std::cout << "TextureCache: wrote " << path << " (" << written / 1024 << " KB)\n";
+#endif
+    return true;
+}
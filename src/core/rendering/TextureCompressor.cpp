@@ -0,0 +1,452 @@
+#include "core/rendering/TextureCompressor.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "core/JobSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PYRE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // ------------------------------------------------------------------------
+    // Mip filtering
+
+    // RGBA bytes, missing channels 0 (alpha 255)
+    std::vector<unsigned char> expand(const ImageData& image)
+    {
+        const size_t count = size_t(image.width) * image.height;
+        std::vector<unsigned char> rgba(count * 4);
+        const unsigned char* src = image.pixels.get();
+        for (size_t i = 0; i < count; ++i, src += image.channels)
+        {
+            unsigned char* dst = &rgba[i * 4];
+            dst[0] = src[0];
+            dst[1] = image.channels >= 2 ? src[1] : 0;
+            dst[2] = image.channels >= 3 ? src[2] : 0;
+            dst[3] = image.channels == 4 ? src[3] : 255;
+        }
+        return rgba;
+    }
+
+    struct Tap
+    {
+        int index;
+        float weight;
+    };
+
+    // Tent filter taps of every destination texel along one axis: the tent reaches
+    // one destination texel (in source texels) either side, and indices wrap around
+    std::vector<std::vector<Tap>> tentTaps(int srcSize, int dstSize)
+    {
+        std::vector<std::vector<Tap>> taps(dstSize);
+        const float scale = float(srcSize) / dstSize;
+        for (int d = 0; d < dstSize; ++d)
+        {
+            const float center = (d + 0.5f) * scale;
+            const int first = static_cast<int>(std::floor(center - scale));
+            const int last = static_cast<int>(std::ceil(center + scale));
+            float sum = 0.0f;
+            for (int i = first; i <= last; ++i)
+            {
+                float weight = 1.0f - std::abs(i + 0.5f - center) / scale;
+                if (weight <= 0.0f) continue;
+                taps[d].push_back({ ((i % srcSize) + srcSize) % srcSize, weight });
+                sum += weight;
+            }
+            for (Tap& tap : taps[d])
+                tap.weight /= sum;
+        }
+        return taps;
+    }
+
+    // One level from the one above, in bytes. Each destination row sums the
+    // source rows under its taps, each filtered horizontally on the way in, so
+    // nothing bigger than a row of sums is kept besides the two levels
+    std::vector<unsigned char> downsample(const std::vector<unsigned char>& src, int srcWidth, int srcHeight,
+        int dstWidth, int dstHeight)
+    {
+        const std::vector<std::vector<Tap>> xTaps = tentTaps(srcWidth, dstWidth);
+        const std::vector<std::vector<Tap>> yTaps = tentTaps(srcHeight, dstHeight);
+
+        std::vector<unsigned char> dst(size_t(dstWidth) * dstHeight * 4);
+        const uint32_t grain = static_cast<uint32_t>(std::max(1, 4096 / dstWidth));
+        JobSystem::ParallelFor(static_cast<uint32_t>(dstHeight), grain, [&](uint32_t begin, uint32_t end) {
+            std::vector<float> sums(size_t(dstWidth) * 4);
+            for (uint32_t y = begin; y < end; ++y)
+            {
+                std::fill(sums.begin(), sums.end(), 0.0f);
+                for (const Tap& row : yTaps[y])
+                {
+                    const unsigned char* line = &src[size_t(row.index) * srcWidth * 4];
+                    for (int x = 0; x < dstWidth; ++x)
+                    {
+                        float* d = &sums[size_t(x) * 4];
+                        for (const Tap& tap : xTaps[x])
+                        {
+                            const unsigned char* s = line + size_t(tap.index) * 4;
+                            const float weight = row.weight * tap.weight;
+                            for (int c = 0; c < 4; ++c)
+                                d[c] += weight * s[c];
+                        }
+                    }
+                }
+                unsigned char* out = &dst[size_t(y) * dstWidth * 4];
+                for (size_t i = 0; i < sums.size(); ++i)
+                    out[i] = static_cast<unsigned char>(std::min(sums[i] + 0.5f, 255.0f));
+            }
+        });
+        return dst;
+    }
+
+    // ------------------------------------------------------------------------
+    // Block encoding
+
+    uint16_t pack565(const float color[3])
+    {
+        auto quantize = [](float v, int levels) {
+            return static_cast<uint16_t>(std::clamp(v, 0.0f, 255.0f) * levels / 255.0f + 0.5f);
+        };
+        return static_cast<uint16_t>((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5)
+            | quantize(color[2], 31));
+    }
+
+    void unpack565(uint16_t packed, float color[3])
+    {
+        const int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = float((r << 3) | (r >> 2));
+        color[1] = float((g << 2) | (g >> 4));
+        color[2] = float((b << 3) | (b >> 2));
+    }
+
+    // Nearest palette entry for every texel; returns the summed squared error
+    float selectColors(const float* r, const float* g, const float* b, const float palette[4][3],
+        uint8_t indices[16])
+    {
+        float error = 0.0f;
+#ifdef PYRE_SSE2
+        for (int i = 0; i < 16; i += 4)
+        {
+            const __m128 pr = _mm_loadu_ps(r + i);
+            const __m128 pg = _mm_loadu_ps(g + i);
+            const __m128 pb = _mm_loadu_ps(b + i);
+            __m128 best = _mm_set1_ps(FLT_MAX);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int k = 0; k < 4; ++k)
+            {
+                const __m128 dr = _mm_sub_ps(pr, _mm_set1_ps(palette[k][0]));
+                const __m128 dg = _mm_sub_ps(pg, _mm_set1_ps(palette[k][1]));
+                const __m128 db = _mm_sub_ps(pb, _mm_set1_ps(palette[k][2]));
+                const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+                    _mm_mul_ps(db, db));
+                const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+                best = _mm_min_ps(d, best);
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)),
+                    _mm_andnot_si128(closer, bestIndex));
+            }
+
+            alignas(16) int32_t picked[4];
+            alignas(16) float distance[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(picked), bestIndex);
+            _mm_store_ps(distance, best);
+            for (int j = 0; j < 4; ++j)
+            {
+                indices[i + j] = static_cast<uint8_t>(picked[j]);
+                error += distance[j];
+            }
+        }
+#else
+        for (int i = 0; i < 16; ++i)
+        {
+            float best = FLT_MAX;
+            for (int k = 0; k < 4; ++k)
+            {
+                const float dr = r[i] - palette[k][0], dg = g[i] - palette[k][1], db = b[i] - palette[k][2];
+                const float d = dr * dr + dg * dg + db * db;
+                if (d < best) { best = d; indices[i] = static_cast<uint8_t>(k); }
+            }
+            error += best;
+        }
+#endif
+        return error;
+    }
+
+    struct ColorBlock
+    {
+        uint16_t color0 = 0;
+        uint16_t color1 = 0;
+        uint8_t indices[16] = {};
+        float error = FLT_MAX;
+    };
+
+    // Indices for a pair of endpoints, ordered for the 4-colour mode (color0 > color1)
+    ColorBlock fitEndpoints(uint16_t color0, uint16_t color1,
+        const float* r, const float* g, const float* b)
+    {
+        ColorBlock block;
+        block.color0 = std::max(color0, color1);
+        block.color1 = std::min(color0, color1);
+
+        float palette[4][3];
+        unpack565(block.color0, palette[0]);
+        unpack565(block.color1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+        block.error = selectColors(r, g, b, palette, block.indices);
+        return block;
+    }
+
+    void encodeColorBlock(const unsigned char* texels, unsigned char* out)
+    {
+        float r[16], g[16], b[16];
+        float mean[3] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            r[i] = texels[i * 4 + 0];
+            g[i] = texels[i * 4 + 1];
+            b[i] = texels[i * 4 + 2];
+            mean[0] += r[i]; mean[1] += g[i]; mean[2] += b[i];
+        }
+        for (float& m : mean) m /= 16.0f;
+
+        // principal axis of the colours: power iteration on the covariance matrix,
+        // from the diagonal of their bounding box
+        float cov[6] = {};
+        float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (int i = 0; i < 16; ++i)
+        {
+            const float d[3] = { r[i] - mean[0], g[i] - mean[1], b[i] - mean[2] };
+            cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+            cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+            const float p[3] = { r[i], g[i], b[i] };
+            for (int c = 0; c < 3; ++c) { lo[c] = std::min(lo[c], p[c]); hi[c] = std::max(hi[c], p[c]); }
+        }
+        float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            const float next[3] = {
+                cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+            const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+            if (length < 1e-6f) break;
+            for (int c = 0; c < 3; ++c) axis[c] = next[c] / length;
+        }
+
+        // the extremes along the axis, pulled in slightly (the ends are rarely hit exactly)
+        float tMin = FLT_MAX, tMax = -FLT_MAX;
+        for (int i = 0; i < 16; ++i)
+        {
+            const float t = (r[i] - mean[0]) * axis[0] + (g[i] - mean[1]) * axis[1] + (b[i] - mean[2]) * axis[2];
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+        const float inset = (tMax - tMin) / 16.0f;
+        tMin += inset;
+        tMax -= inset;
+        float end0[3], end1[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            end0[c] = mean[c] + axis[c] * tMax;
+            end1[c] = mean[c] + axis[c] * tMin;
+        }
+        ColorBlock best = fitEndpoints(pack565(end0), pack565(end1), r, g, b);
+
+        // least-squares endpoints for the chosen indices
+        static const float weight0[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f, ap[3] = {}, bp[3] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            const float a = weight0[best.indices[i]], w = 1.0f - a;
+            const float p[3] = { r[i], g[i], b[i] };
+            aa += a * a; bb += w * w; ab += a * w;
+            for (int c = 0; c < 3; ++c) { ap[c] += a * p[c]; bp[c] += w * p[c]; }
+        }
+        const float det = aa * bb - ab * ab;
+        if (std::abs(det) > 1e-6f)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                end0[c] = (bb * ap[c] - ab * bp[c]) / det;
+                end1[c] = (aa * bp[c] - ab * ap[c]) / det;
+            }
+            ColorBlock refined = fitEndpoints(pack565(end0), pack565(end1), r, g, b);
+            if (refined.error < best.error) best = refined;
+        }
+
+        uint32_t bits = 0;
+        if (best.color0 != best.color1)
+            for (int i = 0; i < 16; ++i)
+                bits |= uint32_t(best.indices[i]) << (2 * i);
+        out[0] = static_cast<unsigned char>(best.color0);
+        out[1] = static_cast<unsigned char>(best.color0 >> 8);
+        out[2] = static_cast<unsigned char>(best.color1);
+        out[3] = static_cast<unsigned char>(best.color1 >> 8);
+        for (int i = 0; i < 4; ++i)
+            out[4 + i] = static_cast<unsigned char>(bits >> (8 * i));
+    }
+
+    // One channel of the texels (BC3 alpha, BC4, half a BC5 block)
+    void encodeValueBlock(const unsigned char* texels, int channel, unsigned char* out)
+    {
+        int lo = 255, hi = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            lo = std::min(lo, int(texels[i * 4 + channel]));
+            hi = std::max(hi, int(texels[i * 4 + channel]));
+        }
+
+        uint64_t bits = 0;
+        if (hi > lo)
+        {
+            // value0 > value1: 8-value palette, codes 2..7 interpolate between them
+            int palette[8] = { hi, lo };
+            for (int code = 2; code < 8; ++code)
+                palette[code] = ((8 - code) * hi + (code - 1) * lo + 3) / 7;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const int value = texels[i * 4 + channel];
+                int bestCode = 0, bestError = 256;
+                for (int code = 0; code < 8; ++code)
+                {
+                    const int error = std::abs(value - palette[code]);
+                    if (error < bestError) { bestError = error; bestCode = code; }
+                }
+                bits |= uint64_t(bestCode) << (3 * i);
+            }
+        }
+
+        out[0] = static_cast<unsigned char>(hi);
+        out[1] = static_cast<unsigned char>(lo);
+        for (int i = 0; i < 6; ++i)
+            out[2 + i] = static_cast<unsigned char>(bits >> (8 * i));
+    }
+
+    // The 4x4 texels of a block; past the edge the last row / column repeats
+    void gatherBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY,
+        unsigned char block[64])
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            const int sy = std::min(blockY * 4 + y, height - 1);
+            for (int x = 0; x < 4; ++x)
+            {
+                const int sx = std::min(blockX * 4 + x, width - 1);
+                std::memcpy(block + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+            }
+        }
+    }
+}
+
+size_t TextureCompressor::BlockBytes(BlockFormat format)
+{
+    return (format == BlockFormat::BC1 || format == BlockFormat::BC4) ? 8 : 16;
+}
+
+size_t TextureCompressor::EncodedSize(BlockFormat format, int width, int height)
+{
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+BlockFormat TextureCompressor::ChooseFormat(const ImageData& image)
+{
+    if (image.channels == 1) return BlockFormat::BC4;
+    if (image.channels == 2) return BlockFormat::BC5;
+    if (image.channels == 4)
+    {
+        const size_t count = size_t(image.width) * image.height;
+        for (size_t i = 0; i < count; ++i)
+            if (image.pixels.get()[i * 4 + 3] != 255) return BlockFormat::BC3;
+    }
+    return BlockFormat::BC1;
+}
+
+std::vector<TextureCompressor::MipLevel> TextureCompressor::BuildMips(const ImageData& image)
+{
+    std::vector<MipLevel> levels(1);
+    levels[0].width = image.width;
+    levels[0].height = image.height;
+    levels[0].rgba = expand(image);
+
+    while (levels.back().width > 1 || levels.back().height > 1)
+    {
+        const MipLevel& above = levels.back();
+        MipLevel level;
+        level.width = std::max(1, above.width / 2);
+        level.height = std::max(1, above.height / 2);
+        level.rgba = downsample(above.rgba, above.width, above.height, level.width, level.height);
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
+
+void TextureCompressor::Encode(BlockFormat format, const unsigned char* rgba, int width, int height,
+    unsigned char* blocks)
+{
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    const size_t blockBytes = BlockBytes(format);
+
+    // a row of blocks per item; chunks of about a thousand blocks
+    const uint32_t grain = static_cast<uint32_t>(std::max(1, 1024 / blocksX));
+    JobSystem::ParallelFor(static_cast<uint32_t>(blocksY), grain, [&](uint32_t begin, uint32_t end) {
+        unsigned char block[64];
+        for (uint32_t by = begin; by < end; ++by)
+            for (int bx = 0; bx < blocksX; ++bx)
+            {
+                gatherBlock(rgba, width, height, bx, static_cast<int>(by), block);
+                unsigned char* out = blocks + (size_t(by) * blocksX + bx) * blockBytes;
+                switch (format)
+                {
+                case BlockFormat::BC1:
+                    encodeColorBlock(block, out);
+                    break;
+                case BlockFormat::BC3:
+                    encodeValueBlock(block, 3, out);
+                    encodeColorBlock(block, out + 8);
+                    break;
+                case BlockFormat::BC4:
+                    encodeValueBlock(block, 0, out);
+                    break;
+                case BlockFormat::BC5:
+                    encodeValueBlock(block, 0, out);
+                    encodeValueBlock(block, 1, out + 8);
+                    break;
+                }
+            }
+    });
+}
+
+CompressedImage TextureCompressor::Compress(const ImageData& image)
+{
+    CompressedImage result;
+    result.format = ChooseFormat(image);
+    result.channels = image.channels;
+
+    const std::vector<MipLevel> mips = BuildMips(image);
+    size_t total = 0;
+    for (const MipLevel& mip : mips)
+    {
+        CompressedImage::Level level;
+        level.width = mip.width;
+        level.height = mip.height;
+        level.offset = total;
+        level.size = EncodedSize(result.format, mip.width, mip.height);
+        total += level.size;
+        result.levels.push_back(level);
+    }
+
+    result.data.resize(total);
+    for (size_t i = 0; i < mips.size(); ++i)
+        Encode(result.format, mips[i].rgba.data(), mips[i].width, mips[i].height,
+            result.data.data() + result.levels[i].offset);
+    return result;
+}
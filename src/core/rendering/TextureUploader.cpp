@@ -0,0 +1,189 @@
+#include "core/rendering/TextureUploader.h"
+#include <algorithm>
+#include "core/rendering/GLState.h"
+#include "core/rendering/Mesh.h"
+#include "core/rendering/TextureCache.h"
+
+std::deque<TextureUploader::Upload> TextureUploader::queue;
+std::vector<TextureUploader::Fenced> TextureUploader::fenced;
+std::unique_ptr<StreamBuffer> TextureUploader::staging;
+size_t TextureUploader::frameBudget = TextureUploader::DEFAULT_FRAME_BUDGET;
+GLuint TextureUploader::placeholder = 0;
+
+GLenum TextureUploader::PixelFormat(int channels)
+{
+    switch (channels)
+    {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+void TextureUploader::Queue(const std::shared_ptr<Texture>& texture,
+    const std::shared_ptr<const ImageDecoder::Job>& source)
+{
+    texture->ready = false;
+    queue.push_back({ texture, source, 0 });
+}
+
+TextureUploader::Rows TextureUploader::rowsOf(const Upload& upload)
+{
+    const CompressedImage& compressed = upload.source->Compressed();
+    if (compressed)
+    {
+        const CompressedImage::Level& level = compressed.levels[upload.level];
+        const int blockRows = (level.height + 3) / 4;
+        return { compressed.LevelData(upload.level), level.size / blockRows, blockRows };
+    }
+    const ImageData& image = upload.source->Image();
+    return { image.pixels.get(), size_t(image.width) * image.channels, image.height };
+}
+
+int TextureUploader::levelCount(const Upload& upload)
+{
+    const CompressedImage& compressed = upload.source->Compressed();
+    return compressed ? static_cast<int>(compressed.levels.size()) : 1;
+}
+
+void TextureUploader::uploadRows(const Upload& upload, const Rows& rows, int first, int count,
+    const void* pixels)
+{
+    GLState::EditTexture(upload.texture->ID);
+
+    const CompressedImage& compressed = upload.source->Compressed();
+    if (compressed)
+    {
+        // whole blocks; only a band that reaches the top may end off the 4-texel grid
+        const CompressedImage::Level& level = compressed.levels[upload.level];
+        const int y = first * 4;
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, y, level.width,
+            std::min(count * 4, level.height - y), TextureCache::InternalFormat(compressed.format),
+            static_cast<GLsizei>(rows.rowBytes * count), pixels);
+        return;
+    }
+
+    const ImageData& image = upload.source->Image();
+    // rows are tightly packed (RGB rows need not be a multiple of 4 bytes)
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, image.width, count, PixelFormat(image.channels),
+        GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void TextureUploader::finish(Upload& upload, bool fence)
+{
+    // compressed images bring their own mips
+    if (!upload.source->Compressed())
+    {
+        GLState::EditTexture(upload.texture->ID);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    upload.source.reset();
+
+    if (!fence)
+    {
+        // commands issued later see the upload anyway
+        upload.texture->ready = true;
+        return;
+    }
+    fenced.push_back({ std::move(upload.texture), glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+}
+
+void TextureUploader::Update()
+{
+    for (size_t i = 0; i < fenced.size();)
+    {
+        GLenum result = glClientWaitSync(fenced[i].fence, 0, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+        {
+            glDeleteSync(fenced[i].fence);
+            fenced[i].texture->ready = true;
+            fenced[i] = std::move(fenced.back());
+            fenced.pop_back();
+        }
+        else
+            ++i;
+    }
+    if (queue.empty()) return;
+
+    if (!staging)
+        staging = std::make_unique<StreamBuffer>(frameBudget);
+    staging->BeginFrame(frameBudget);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging->Buffer());
+
+    size_t remaining = frameBudget;
+    while (!queue.empty())
+    {
+        Upload& upload = queue.front();
+        const Rows rows = rowsOf(upload);
+
+        // whole rows that fit, and at least one so a tiny budget still makes progress
+        int count = std::min(rows.count - upload.nextRow, static_cast<int>(remaining / rows.rowBytes));
+        if (count == 0 && remaining < frameBudget) break;
+        count = std::max(count, 1);
+
+        const size_t bytes = rows.rowBytes * count;
+        const size_t offset = staging->Write(rows.data + rows.rowBytes * upload.nextRow, bytes, 4);
+        if (offset == StreamBuffer::FULL) break;    // the buffer grows next frame
+
+        uploadRows(upload, rows, upload.nextRow, count, (const void*)offset);
+        upload.nextRow += count;
+        remaining -= std::min(remaining, bytes);
+
+        if (upload.nextRow < rows.count) break;     // budget spent inside this level
+        upload.nextRow = 0;
+        if (++upload.level < levelCount(upload)) continue;
+        finish(upload, true);
+        queue.pop_front();
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    staging->EndFrame();
+    // so the fences signal without waiting for the next swap
+    if (!fenced.empty()) glFlush();
+}
+
+void TextureUploader::Flush()
+{
+    for (Upload& upload : queue)
+    {
+        for (; upload.level < levelCount(upload); ++upload.level, upload.nextRow = 0)
+        {
+            const Rows rows = rowsOf(upload);
+            uploadRows(upload, rows, upload.nextRow, rows.count - upload.nextRow,
+                rows.data + rows.rowBytes * upload.nextRow);
+        }
+        finish(upload, false);
+    }
+    queue.clear();
+}
+
+GLuint TextureUploader::Placeholder()
+{
+    if (placeholder) return placeholder;
+
+    const unsigned char white[4] = { 255, 255, 255, 255 };
+    glGenTextures(1, &placeholder);
+    GLState::EditTexture(placeholder);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return placeholder;
+}
+
+void TextureUploader::Clear()
+{
+    queue.clear();
+    for (Fenced& f : fenced)
+        glDeleteSync(f.fence);
+    fenced.clear();
+    staging.reset();
+    if (placeholder)
+    {
+        GLState::ForgetTexture(placeholder);
+        glDeleteTextures(1, &placeholder);
+        placeholder = 0;
+    }
+}
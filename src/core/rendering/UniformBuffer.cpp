@@ -0,0 +1,74 @@
+#include "core/rendering/UniformBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+UniformRingBuffer::UniformRingBuffer(GLuint bindingPoint, std::size_t blockSize, int slotCount)
+    : binding(bindingPoint), blockSize(blockSize), slotCount(std::clamp(slotCount, 1, MAX_SLOTS))
+{
+}
+
+UniformRingBuffer::~UniformRingBuffer()
+{
+    for (GLsync& fence : fences)
+        if (fence) { glDeleteSync(fence); fence = nullptr; }
+    if (buffer) glDeleteBuffers(1, &buffer);
+}
+
+void UniformRingBuffer::create()
+{
+    // every slot must start on a multiple of the implementation's offset alignment
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    slotStride = (blockSize + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, slotStride * slotCount, nullptr, GL_DYNAMIC_DRAW);
+}
+
+void UniformRingBuffer::waitForSlot(int slot)
+{
+    GLsync& fence = fences[slot];
+    if (!fence) return;
+
+    // 1 ms steps; in practice the fence of a slot written 3 frames ago has long signalled
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    while (result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(fence, 0, 1000000);
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void UniformRingBuffer::Write(const void* data)
+{
+    if (!buffer) create();
+
+    current = (current + 1) % slotCount;
+    waitForSlot(current);
+
+    // the fence guarantees the GPU is done with this slot, so skip the driver's own sync
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    void* dst = glMapBufferRange(GL_UNIFORM_BUFFER, current * slotStride, blockSize,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (dst)
+    {
+        std::memcpy(dst, data, blockSize);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+
+    Bind();
+}
+
+void UniformRingBuffer::Bind() const
+{
+    if (current < 0) return;
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, current * slotStride, blockSize);
+}
+
+void UniformRingBuffer::Fence()
+{
+    if (current < 0) return;
+    if (fences[current]) glDeleteSync(fences[current]);
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
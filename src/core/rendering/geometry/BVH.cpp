@@ -0,0 +1,569 @@
+#include "core/rendering/geometry/BVH.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include "core/rendering/Mesh.h"
+#include "core/JobSystem.h"
+
+namespace
+{
+    constexpr int BIN_COUNT = 16;
+    // relative to intersecting one primitive
+    constexpr float TRAVERSAL_COST = 1.0f;
+    // nodes at least this large compute bounds and bins on every thread
+    constexpr uint32_t PARALLEL_BIN_THRESHOLD = 65536;
+    constexpr uint32_t PARALLEL_BIN_GRAIN = 16384;
+    // subtrees smaller than this are never split off as a separate task
+    constexpr uint32_t MIN_SUBTREE = 4096;
+    using BVH::STACK_SIZE;
+
+    struct Aabb
+    {
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+
+        void Grow(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+        void Grow(const glm::vec3& lo, const glm::vec3& hi) { min = glm::min(min, lo); max = glm::max(max, hi); }
+        void Grow(const Aabb& b) { Grow(b.min, b.max); }
+
+        float Area() const
+        {
+            glm::vec3 e = max - min;
+            return e.x < 0.0f ? 0.0f : 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+    };
+
+    struct Bin
+    {
+        Aabb bounds;
+        uint32_t count = 0;
+    };
+    using Bins = std::array<std::array<Bin, BIN_COUNT>, 3>;
+
+    struct Task
+    {
+        uint32_t node;
+        uint32_t first;
+        uint32_t count;
+        uint32_t depth;
+    };
+
+    // Primitives are partitioned by value, so every pass over a node reads memory in order
+    struct Primitive
+    {
+        glm::vec3 min;
+        uint32_t id;
+        glm::vec3 max;
+        float pad;
+
+        glm::vec3 Centroid() const { return (min + max) * 0.5f; }
+    };
+
+    struct Builder
+    {
+        std::vector<Primitive> primitives;
+        uint32_t maxLeafSize;
+
+        // box and centroid bounds of primitives[first, first + count)
+        void measure(const Task& task, Aabb& bounds, Aabb& centroidBounds, bool parallel) const
+        {
+            auto range = [&](uint32_t begin, uint32_t end, Aabb& b, Aabb& c) {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    const Primitive& p = primitives[task.first + i];
+                    b.Grow(p.min, p.max);
+                    c.Grow(p.Centroid());
+                }
+            };
+            if (!parallel)
+            {
+                range(0, task.count, bounds, centroidBounds);
+                return;
+            }
+
+            const uint32_t chunks = (task.count + PARALLEL_BIN_GRAIN - 1) / PARALLEL_BIN_GRAIN;
+            std::vector<Aabb> partial(chunks * 2);
+            JobSystem::ParallelFor(task.count, PARALLEL_BIN_GRAIN, [&](uint32_t begin, uint32_t end) {
+                const uint32_t chunk = begin / PARALLEL_BIN_GRAIN;
+                range(begin, end, partial[chunk * 2], partial[chunk * 2 + 1]);
+            });
+            for (uint32_t c = 0; c < chunks; ++c)
+            {
+                bounds.Grow(partial[c * 2]);
+                centroidBounds.Grow(partial[c * 2 + 1]);
+            }
+        }
+
+        void bin(const Task& task, const Aabb& centroidBounds, const glm::vec3& scale, Bins& bins, bool parallel) const
+        {
+            auto range = [&](uint32_t begin, uint32_t end, Bins& out) {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    const Primitive& p = primitives[task.first + i];
+                    const glm::vec3 centroid = p.Centroid();
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        int b = std::min(BIN_COUNT - 1,
+                            static_cast<int>((centroid[axis] - centroidBounds.min[axis]) * scale[axis]));
+                        out[axis][b].bounds.Grow(p.min, p.max);
+                        out[axis][b].count++;
+                    }
+                }
+            };
+            if (!parallel)
+            {
+                range(0, task.count, bins);
+                return;
+            }
+
+            const uint32_t chunks = (task.count + PARALLEL_BIN_GRAIN - 1) / PARALLEL_BIN_GRAIN;
+            std::vector<Bins> partial(chunks);
+            JobSystem::ParallelFor(task.count, PARALLEL_BIN_GRAIN, [&](uint32_t begin, uint32_t end) {
+                range(begin, end, partial[begin / PARALLEL_BIN_GRAIN]);
+            });
+            for (const Bins& p : partial)
+                for (int axis = 0; axis < 3; ++axis)
+                    for (int b = 0; b < BIN_COUNT; ++b)
+                    {
+                        bins[axis][b].bounds.Grow(p[axis][b].bounds);
+                        bins[axis][b].count += p[axis][b].count;
+                    }
+        }
+
+        // Fills in the node's bounds; returns false (and makes it a leaf) when splitting
+        // does not pay off, otherwise the end of the left half in `mid`
+        bool split(const Task& task, BVH::Node& node, uint32_t& mid, bool parallel)
+        {
+            Aabb bounds, centroidBounds;
+            measure(task, bounds, centroidBounds, parallel);
+            node.min = bounds.min;
+            node.max = bounds.max;
+            node.leftOrFirst = task.first;
+            node.count = task.count;
+            if (task.count <= 1) return false;
+
+            const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+            if (task.depth >= BVH::SAH_DEPTH)
+                return splitMedian(task, extent, mid);
+
+            float bestCost = FLT_MAX;
+            int bestAxis = -1, bestBin = 0;
+
+            if (glm::max(extent.x, glm::max(extent.y, extent.z)) > 0.0f)
+            {
+                glm::vec3 scale;
+                for (int axis = 0; axis < 3; ++axis)
+                    scale[axis] = extent[axis] > 0.0f ? BIN_COUNT / extent[axis] : 0.0f;
+
+                Bins bins;
+                bin(task, centroidBounds, scale, bins, parallel);
+
+                // sweep: cost of splitting after bin b, for every axis
+                const float invArea = 1.0f / std::max(bounds.Area(), 1e-30f);
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    if (extent[axis] <= 0.0f) continue;
+
+                    float rightCost[BIN_COUNT];
+                    Aabb right;
+                    uint32_t rightCount = 0;
+                    for (int b = BIN_COUNT - 1; b > 0; --b)
+                    {
+                        right.Grow(bins[axis][b].bounds);
+                        rightCount += bins[axis][b].count;
+                        rightCost[b] = right.Area() * rightCount;
+                    }
+
+                    Aabb left;
+                    uint32_t leftCount = 0;
+                    for (int b = 0; b < BIN_COUNT - 1; ++b)
+                    {
+                        left.Grow(bins[axis][b].bounds);
+                        leftCount += bins[axis][b].count;
+                        if (leftCount == 0 || leftCount == task.count) continue;
+
+                        float cost = TRAVERSAL_COST + (left.Area() * leftCount + rightCost[b + 1]) * invArea;
+                        if (cost < bestCost)
+                        {
+                            bestCost = cost;
+                            bestAxis = axis;
+                            bestBin = b;
+                        }
+                    }
+                }
+            }
+
+            if (bestAxis < 0 || bestCost >= static_cast<float>(task.count))
+            {
+                if (task.count <= maxLeafSize) return false;
+            }
+
+            Primitive* begin = primitives.data() + task.first;
+            Primitive* end = begin + task.count;
+            Primitive* middle = begin;
+            if (bestAxis >= 0)
+            {
+                const float lo = centroidBounds.min[bestAxis];
+                const float binScale = BIN_COUNT / extent[bestAxis];
+                middle = std::partition(begin, end, [&](const Primitive& p) {
+                    int b = std::min(BIN_COUNT - 1, static_cast<int>((p.Centroid()[bestAxis] - lo) * binScale));
+                    return b <= bestBin;
+                });
+            }
+            // identical centroids (or a degenerate partition): halve by position in the list
+            if (middle == begin || middle == end)
+                middle = begin + task.count / 2;
+
+            mid = static_cast<uint32_t>(middle - primitives.data());
+            return true;
+        }
+
+        // Halves the node along its widest centroid axis (bounds the depth; see BVH::SAH_DEPTH)
+        bool splitMedian(const Task& task, const glm::vec3& extent, uint32_t& mid)
+        {
+            if (task.count <= maxLeafSize) return false;
+
+            const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            Primitive* begin = primitives.data() + task.first;
+            Primitive* middle = begin + task.count / 2;
+            std::nth_element(begin, middle, begin + task.count, [axis](const Primitive& a, const Primitive& b) {
+                return a.Centroid()[axis] < b.Centroid()[axis];
+            });
+            mid = static_cast<uint32_t>(middle - primitives.data());
+            return true;
+        }
+
+        // Both children of an interior node at `task`'s depth
+        static void pushChildren(std::vector<Task>& stack, const Task& task, uint32_t left, uint32_t mid,
+            bool leftFirst)
+        {
+            assert(task.depth < BVH::MAX_DEPTH);
+            const Task l{ left, task.first, mid - task.first, task.depth + 1 };
+            const Task r{ left + 1, mid, task.first + task.count - mid, task.depth + 1 };
+            stack.push_back(leftFirst ? l : r);
+            stack.push_back(leftFirst ? r : l);
+        }
+
+        // Serial build of one subtree whose root is nodes[root]
+        void buildSubtree(std::vector<BVH::Node>& nodes, const Task& rootTask)
+        {
+            std::vector<Task> stack{ rootTask };
+            while (!stack.empty())
+            {
+                Task task = stack.back();
+                stack.pop_back();
+
+                BVH::Node node;
+                uint32_t mid;
+                bool interior = split(task, node, mid, false);
+                if (interior)
+                {
+                    node.leftOrFirst = static_cast<uint32_t>(nodes.size());
+                    node.count = 0;
+                    nodes.emplace_back();
+                    nodes.emplace_back();
+                    // left on top, so it is built first
+                    pushChildren(stack, task, node.leftOrFirst, mid, false);
+                }
+                nodes[task.node] = node;
+            }
+        }
+
+        // Splits the top of the tree here (binning on every thread), then builds the
+        // subtrees below subtreeSize on the job system and appends them to nodes
+        void buildParallel(std::vector<BVH::Node>& nodes, uint32_t count, uint32_t subtreeSize)
+        {
+            // top of the tree
+            std::vector<Task> pending{ { 0, 0, count, 0 } };
+            std::vector<Task> subtrees;
+            while (!pending.empty())
+            {
+                Task task = pending.back();
+                pending.pop_back();
+                if (task.count <= subtreeSize)
+                {
+                    subtrees.push_back(task);
+                    continue;
+                }
+
+                BVH::Node node;
+                uint32_t mid;
+                if (split(task, node, mid, task.count >= PARALLEL_BIN_THRESHOLD))
+                {
+                    node.leftOrFirst = static_cast<uint32_t>(nodes.size());
+                    node.count = 0;
+                    nodes.emplace_back();
+                    nodes.emplace_back();
+                    pushChildren(pending, task, node.leftOrFirst, mid, true);
+                }
+                nodes[task.node] = node;
+            }
+
+            // subtrees, each into its own array with its root at 0
+            std::vector<std::vector<BVH::Node>> built(subtrees.size());
+            JobSystem::ParallelFor(static_cast<uint32_t>(subtrees.size()), 1, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t s = begin; s < end; ++s)
+                {
+                    built[s].emplace_back();
+                    buildSubtree(built[s], { 0, subtrees[s].first, subtrees[s].count, subtrees[s].depth });
+                }
+            });
+
+            // the root goes into the reserved slot, the rest is appended (child links shifted)
+            for (size_t s = 0; s < subtrees.size(); ++s)
+            {
+                const uint32_t base = static_cast<uint32_t>(nodes.size()) - 1;
+                for (size_t i = 0; i < built[s].size(); ++i)
+                {
+                    BVH::Node node = built[s][i];
+                    if (!node.IsLeaf()) node.leftOrFirst += base;
+                    if (i == 0) nodes[subtrees[s].node] = node;
+                    else nodes.push_back(node);
+                }
+            }
+        }
+    };
+
+    // Moller-Trumbore, two-sided (the engine does not cull back faces either)
+    bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction,
+        const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float tMax,
+        float& t, glm::vec2& barycentric)
+    {
+        const glm::vec3 e1 = v1 - v0;
+        const glm::vec3 e2 = v2 - v0;
+        const glm::vec3 p = glm::cross(direction, e2);
+        const float det = glm::dot(e1, p);
+        if (std::abs(det) < 1e-20f) return false;
+
+        const float invDet = 1.0f / det;
+        const glm::vec3 s = origin - v0;
+        const float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) return false;
+
+        const glm::vec3 q = glm::cross(s, e1);
+        const float v = glm::dot(direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) return false;
+
+        const float hit = glm::dot(e2, q) * invDet;
+        if (hit < 0.0f || hit >= tMax) return false;
+        t = hit;
+        barycentric = glm::vec2(u, v);
+        return true;
+    }
+}
+
+// --------------------------------------------
+// Build - big builds split the top of the tree on the calling thread (binning
+// in parallel) until there are enough independent subtrees for every worker,
+// then build those on the job system and append them to the node array
+// --------------------------------------------
+void BVH::Build(const glm::vec3* boxMin, const glm::vec3* boxMax, uint32_t count, uint32_t maxLeafSize,
+    std::vector<Node>& nodes, std::vector<uint32_t>& order)
+{
+    nodes.clear();
+    order.clear();
+    if (count == 0) return;
+
+    Builder builder{ std::vector<Primitive>(count), std::max(maxLeafSize, 1u) };
+    for (uint32_t i = 0; i < count; ++i)
+        builder.primitives[i] = { boxMin[i], i, boxMax[i], 0.0f };
+
+    nodes.reserve(count / std::max(builder.maxLeafSize / 2, 1u) * 2 + 1);
+    nodes.emplace_back();
+
+    const unsigned threads = JobSystem::WorkerCount() + 1;
+    const uint32_t subtreeSize = std::max(MIN_SUBTREE, count / (threads * 8));
+    if (threads == 1 || count <= subtreeSize)
+        builder.buildSubtree(nodes, { 0, 0, count, 0 });
+    else
+        builder.buildParallel(nodes, count, subtreeSize);
+
+    order.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+        order[i] = builder.primitives[i].id;
+}
+
+glm::vec3 BVH::InverseDirection(const glm::vec3& direction)
+{
+    glm::vec3 inv;
+    for (int i = 0; i < 3; ++i)
+        inv[i] = 1.0f / (std::abs(direction[i]) > 1e-20f ? direction[i] : std::copysign(1e-20f, direction[i]));
+    return inv;
+}
+
+float BVH::IntersectNode(const Node& node, const glm::vec3& origin, const glm::vec3& invDirection, float tMax)
+{
+    const glm::vec3 t1 = (node.min - origin) * invDirection;
+    const glm::vec3 t2 = (node.max - origin) * invDirection;
+    const glm::vec3 lo = glm::min(t1, t2);
+    const glm::vec3 hi = glm::max(t1, t2);
+    const float enter = glm::max(glm::max(lo.x, lo.y), glm::max(lo.z, 0.0f));
+    const float exit = glm::min(glm::min(hi.x, hi.y), glm::min(hi.z, tMax));
+    return enter <= exit ? enter : FLT_MAX;
+}
+
+// ----------------------------------------------------------------------------
+// MeshBVH
+// ----------------------------------------------------------------------------
+MeshBVH::MeshBVH(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+{
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    std::vector<glm::vec3> boxMin(triangleCount), boxMax(triangleCount);
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        const glm::vec3& a = vertices[indices[t * 3]].Position;
+        const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+        const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+        boxMin[t] = glm::min(a, glm::min(b, c));
+        boxMax[t] = glm::max(a, glm::max(b, c));
+    }
+
+    BVH::Build(boxMin.data(), boxMax.data(), triangleCount, 4, nodes, ids);
+
+    positions.resize(size_t(triangleCount) * 3);
+    for (uint32_t i = 0; i < triangleCount; ++i)
+        for (int k = 0; k < 3; ++k)
+            positions[i * 3 + k] = vertices[indices[ids[i] * 3 + k]].Position;
+}
+
+MeshBVH::MeshBVH(const BVH::Node* nodes, size_t nodeCount, const glm::vec3* positions,
+    const uint32_t* ids, size_t triangleCount)
+    : nodes(nodes, nodes + nodeCount),
+    positions(positions, positions + triangleCount * 3),
+    ids(ids, ids + triangleCount)
+{
+}
+
+size_t MeshBVH::MemoryBytes() const
+{
+    return nodes.size() * sizeof(BVH::Node) + positions.size() * sizeof(glm::vec3)
+        + ids.size() * sizeof(uint32_t);
+}
+
+bool MeshBVH::Raycast(const Ray& ray, RayHit& hit) const
+{
+    if (nodes.empty()) return false;
+
+    const glm::vec3 invDirection = BVH::InverseDirection(ray.direction);
+    float closest = std::min(hit.t, ray.tMax);
+    if (BVH::IntersectNode(nodes[0], ray.origin, invDirection, closest) == FLT_MAX) return false;
+
+    bool found = false;
+    uint32_t stack[STACK_SIZE];
+    int top = 0;
+    uint32_t current = 0;
+    while (true)
+    {
+        const BVH::Node& node = nodes[current];
+        if (node.IsLeaf())
+        {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+            {
+                float t;
+                glm::vec2 barycentric;
+                if (intersectTriangle(ray.origin, ray.direction,
+                    positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2], closest, t, barycentric))
+                {
+                    closest = t;
+                    hit.t = t;
+                    hit.triangle = ids[i];
+                    hit.barycentric = barycentric;
+                    found = true;
+                }
+            }
+        }
+        else
+        {
+            // nearer child first; the other one waits on the stack
+            uint32_t nearChild = node.leftOrFirst, farChild = node.leftOrFirst + 1;
+            float tNear = BVH::IntersectNode(nodes[nearChild], ray.origin, invDirection, closest);
+            float tFar = BVH::IntersectNode(nodes[farChild], ray.origin, invDirection, closest);
+            if (tFar < tNear)
+            {
+                std::swap(nearChild, farChild);
+                std::swap(tNear, tFar);
+            }
+            if (tNear != FLT_MAX)
+            {
+                if (tFar != FLT_MAX) stack[top++] = farChild;
+                current = nearChild;
+                continue;
+            }
+        }
+
+        // pop, skipping nodes that are now behind the closest hit
+        bool next = false;
+        while (top > 0 && !next)
+        {
+            current = stack[--top];
+            next = BVH::IntersectNode(nodes[current], ray.origin, invDirection, closest) != FLT_MAX;
+        }
+        if (!next) break;
+    }
+    return found;
+}
+
+bool MeshBVH::RaycastAny(const Ray& ray) const
+{
+    if (nodes.empty()) return false;
+
+    const glm::vec3 invDirection = BVH::InverseDirection(ray.direction);
+    uint32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BVH::Node& node = nodes[stack[--top]];
+        if (BVH::IntersectNode(node, ray.origin, invDirection, ray.tMax) == FLT_MAX) continue;
+
+        if (!node.IsLeaf())
+        {
+            stack[top++] = node.leftOrFirst + 1;
+            stack[top++] = node.leftOrFirst;
+            continue;
+        }
+        for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+        {
+            float t;
+            glm::vec2 barycentric;
+            if (intersectTriangle(ray.origin, ray.direction,
+                positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2], ray.tMax, t, barycentric))
+                return true;
+        }
+    }
+    return false;
+}
+
+void MeshBVH::QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& triangles) const
+{
+    if (nodes.empty()) return;
+
+    auto overlaps = [&](const glm::vec3& lo, const glm::vec3& hi) {
+        return glm::all(glm::lessThanEqual(lo, max)) && glm::all(glm::greaterThanEqual(hi, min));
+    };
+
+    uint32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BVH::Node& node = nodes[stack[--top]];
+        if (!overlaps(node.min, node.max)) continue;
+
+        if (!node.IsLeaf())
+        {
+            stack[top++] = node.leftOrFirst + 1;
+            stack[top++] = node.leftOrFirst;
+            continue;
+        }
+        for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+        {
+            const glm::vec3& a = positions[i * 3];
+            const glm::vec3& b = positions[i * 3 + 1];
+            const glm::vec3& c = positions[i * 3 + 2];
+            if (overlaps(glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c))))
+                triangles.push_back(ids[i]);
+        }
+    }
+}
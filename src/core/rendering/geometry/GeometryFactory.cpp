@@ -1,47 +1,179 @@
 #include "core/rendering/geometry/GeometryFactory.h"
-#include <array>
+#include <algorithm>
 #include <numbers>
 #include <cmath>
+#include <map>
 #include <glm/glm.hpp>
 
-using namespace GeometryFactory;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PYRE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// LOD levels are rebuilt from the shape itself (see withLods), not simplified;
+// only the full-detail level carries a BVH for ray and box queries
+static const MeshOptions FACTORY_OPTIONS{ VertexFormat::Standard, false, 0, nullptr, true };
+static const MeshOptions FACTORY_LOD_OPTIONS{ VertexFormat::Standard, false, 0 };
+
+// curved shapes get up to this many levels, each with half the segments (and rings);
+// a level needs at least MIN_LOD_TRIANGLES, so cubes and planes never get one
+static constexpr int FACTORY_LOD_LEVELS = 3;
+static constexpr int MIN_LOD_TRIANGLES = 64;
+
+// --------------------------------------------
+// Every builder sizes its vertex and index arrays exactly before writing them
+// and hands them to the Mesh by move: no growth, no per-vertex insert and no
+// copy on the way to the pool. Trig comes from one sin/cos table per ring and
+// per segment instead of per vertex.
+// --------------------------------------------
+
+// sin/cos of i * (range / steps) for i in [0, steps]
+struct SinCosTable
+{
+    std::vector<float> sin;
+    std::vector<float> cos;
+
+    SinCosTable(int steps, double range) : sin(steps + 1), cos(steps + 1)
+    {
+        for (int i = 0; i <= steps; ++i)
+        {
+            double angle = range * i / steps;
+            double s = std::sin(angle), c = std::cos(angle);
+            // exact zeros at multiples of pi/2 keep poles and seams watertight
+            sin[i] = static_cast<float>(std::abs(s) < 1e-12 ? 0.0 : s);
+            cos[i] = static_cast<float>(std::abs(c) < 1e-12 ? 0.0 : c);
+        }
+        // a full turn ends exactly where it started
+        if (std::abs(range - 2.0 * std::numbers::pi) < 1e-12)
+        {
+            sin[steps] = sin[0];
+            cos[steps] = cos[0];
+        }
+    }
+};
+
+// One ring of a surface of revolution, segments + 1 vertices around the y axis:
+//   position = (radius * cos, y, radius * sin)
+//   normal   = (normalRadius * cos, normalY, normalRadius * sin)
+//   uv       = (x / segments, v)
+static void writeRing(Vertex* out, const SinCosTable& around, int segments,
+    float radius, float y, float normalRadius, float normalY, float v)
+{
+    const int count = segments + 1;
+    const float du = 1.0f / segments;
+    int x = 0;
+#ifdef PYRE_SSE2
+    const __m128 r = _mm_set1_ps(radius);
+    const __m128 nr = _mm_set1_ps(normalRadius);
+    const __m128 py = _mm_set1_ps(y);
+    const __m128 ny = _mm_set1_ps(normalY);
+    const __m128 tv = _mm_set1_ps(v);
+    const __m128 step = _mm_set1_ps(du);
+    for (; x + 4 <= count; x += 4)
+    {
+        const __m128 c = _mm_loadu_ps(&around.cos[x]);
+        const __m128 s = _mm_loadu_ps(&around.sin[x]);
+        __m128 px = _mm_mul_ps(r, c);
+        __m128 pz = _mm_mul_ps(r, s);
+        __m128 nx = _mm_mul_ps(nr, c);
+        __m128 nz = _mm_mul_ps(nr, s);
+        __m128 pyy = py;
+        __m128 nyy = ny;
+        __m128 tu = _mm_mul_ps(_mm_setr_ps(float(x), float(x + 1), float(x + 2), float(x + 3)), step);
+        __m128 tvv = tv;
+
+        // SoA -> four 32-byte Vertex records: (px py pz nx) then (ny nz u v)
+        _MM_TRANSPOSE4_PS(px, pyy, pz, nx);
+        _MM_TRANSPOSE4_PS(nyy, nz, tu, tvv);
+        float* dst = &out[x].Position.x;
+        _mm_storeu_ps(dst + 0, px);  _mm_storeu_ps(dst + 4, nyy);
+        _mm_storeu_ps(dst + 8, pyy); _mm_storeu_ps(dst + 12, nz);
+        _mm_storeu_ps(dst + 16, pz); _mm_storeu_ps(dst + 20, tu);
+        _mm_storeu_ps(dst + 24, nx); _mm_storeu_ps(dst + 28, tvv);
+    }
+#endif
+    for (; x < count; ++x)
+    {
+        const float c = around.cos[x], s = around.sin[x];
+        out[x] = { { radius * c, y, radius * s }, { normalRadius * c, normalY, normalRadius * s },
+            { x * du, v } };
+    }
+}
+
+// Flat disc cap at height y: center vertex, then segments + 1 rim vertices
+static void writeCap(Vertex* out, const SinCosTable& around, int segments, float radius, float y, float normalY)
+{
+    out[0] = { { 0.0f, y, 0.0f }, { 0.0f, normalY, 0.0f }, { 0.5f, 0.5f } };
+    for (int i = 0; i <= segments; ++i)
+    {
+        const float c = around.cos[i], s = around.sin[i];
+        out[i + 1] = { { radius * c, y, radius * s }, { 0.0f, normalY, 0.0f },
+            { (c + 1.0f) * 0.5f, (s + 1.0f) * 0.5f } };
+    }
+}
 
-static inline void pushVertex(std::vector<float>& v, glm::vec3 pos, glm::vec3 n, glm::vec2 uv)
+// Two triangles per cell of a (columns + 1) x (rows + 1) vertex grid starting at `base`
+static unsigned int* writeGrid(unsigned int* out, unsigned int base, int columns, int rows)
 {
-    v.insert(v.end(), { pos.x, pos.y, pos.z, n.x, n.y, n.z, uv.x, uv.y });
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < columns; ++x)
+        {
+            const unsigned int i0 = base + y * (columns + 1) + x;
+            const unsigned int i1 = i0 + columns + 1;
+            out[0] = i0; out[1] = i1; out[2] = i0 + 1;
+            out[3] = i1; out[4] = i1 + 1; out[5] = i0 + 1;
+            out += 6;
+        }
+    }
+    return out;
+}
+
+// Fan from `center` over rim vertices center+1 .. center+segments+1; `flip` reverses winding
+static unsigned int* writeFan(unsigned int* out, unsigned int center, int segments, bool flip)
+{
+    for (int i = 0; i < segments; ++i)
+    {
+        out[0] = center;
+        out[1] = center + i + (flip ? 2 : 1);
+        out[2] = center + i + (flip ? 1 : 2);
+        out += 3;
+    }
+    return out;
 }
 
 // ------------------------------------------------------------
 // CUBE
 // ------------------------------------------------------------
-Mesh GeometryFactory::CreateCube(float size)
+static Mesh buildCube(float size)
 {
     const float h = size * 0.5f;
-    std::vector<float> data;
-    std::vector<unsigned int> indices;
+    std::vector<Vertex> vertices(24);
+    std::vector<unsigned int> indices(36);
 
-    glm::vec3 positions[8] = {
+    const glm::vec3 positions[8] = {
         {-h,-h,-h}, { h,-h,-h}, { h, h,-h}, {-h, h,-h}, // back
         {-h,-h, h}, { h,-h, h}, { h, h, h}, {-h, h, h}  // front
     };
 
-    glm::vec3 normals[6] = {
+    const glm::vec3 normals[6] = {
         { 0,  0, -1}, { 0,  0,  1}, { 1,  0,  0},
         {-1,  0,  0}, { 0,  1,  0}, { 0, -1,  0}
     };
 
-    glm::vec2 uvs[4] = { {0,0}, {1,0}, {1,1}, {0,1} };
+    const glm::vec2 uvs[4] = { {0,0}, {1,0}, {1,1}, {0,1} };
 
-    // Front face (0123 style indexing)
+    // four corners per face (0-1-2-3 style indexing), two triangles each
+    int face = 0;
     auto quad = [&](int a, int b, int c, int d, glm::vec3 n)
         {
-            unsigned int startIndex = data.size() / 8;
-            pushVertex(data, positions[a], n, uvs[0]);
-            pushVertex(data, positions[b], n, uvs[1]);
-            pushVertex(data, positions[c], n, uvs[2]);
-            pushVertex(data, positions[d], n, uvs[3]);
-            indices.insert(indices.end(), { startIndex, startIndex + 1, startIndex + 2,
-                                            startIndex, startIndex + 2, startIndex + 3 });
+            const unsigned int first = face * 4;
+            const int corners[4] = { a, b, c, d };
+            for (int k = 0; k < 4; ++k)
+                vertices[first + k] = { positions[corners[k]], n, uvs[k] };
+            const unsigned int quadIndices[6] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+            std::copy(quadIndices, quadIndices + 6, indices.begin() + face * 6);
+            ++face;
         };
 
     quad(4, 5, 6, 7, normals[1]); // front
@@ -51,259 +183,269 @@ Mesh GeometryFactory::CreateCube(float size)
     quad(3, 7, 6, 2, normals[4]); // top
     quad(0, 1, 5, 4, normals[5]); // bottom
 
-    return Mesh::CreateFromIndexedData(
-        data.data(), data.size() * sizeof(float),
-        indices.data(), indices.size() * sizeof(unsigned int),
-        indices.size()
-    );
+    return Mesh(std::move(vertices), std::move(indices), FACTORY_OPTIONS);
 }
 
 // ------------------------------------------------------------
 // PLANE
 // ------------------------------------------------------------
-Mesh GeometryFactory::CreatePlane(float size)
+static Mesh buildPlane(float size)
 {
     float h = size * 0.5f;
-    std::vector<float> data;
+    std::vector<Vertex> vertices = {
+        { { -h, 0, -h }, { 0, 1, 0 }, { 0, 0 } },
+        { {  h, 0, -h }, { 0, 1, 0 }, { 1, 0 } },
+        { {  h, 0,  h }, { 0, 1, 0 }, { 1, 1 } },
+        { { -h, 0,  h }, { 0, 1, 0 }, { 0, 1 } }
+    };
     std::vector<unsigned int> indices = { 0,1,2, 0,2,3 };
 
-    pushVertex(data, { -h,0,-h }, { 0,1,0 }, { 0,0 });
-    pushVertex(data, { h,0,-h }, { 0,1,0 }, { 1,0 });
-    pushVertex(data, { h,0, h }, { 0,1,0 }, { 1,1 });
-    pushVertex(data, { -h,0, h }, { 0,1,0 }, { 0,1 });
-
-    return Mesh::CreateFromIndexedData(
-        data.data(), data.size() * sizeof(float),
-        indices.data(), indices.size() * sizeof(unsigned int),
-        indices.size()
-    );
+    return Mesh(std::move(vertices), std::move(indices), FACTORY_OPTIONS);
 }
 
 // ------------------------------------------------------------
 // SPHERE
 // ------------------------------------------------------------
-Mesh GeometryFactory::CreateSphere(float radius, int segments, int rings)
+static Mesh buildSphere(float radius, int segments, int rings, const MeshOptions& options = FACTORY_OPTIONS)
 {
-    std::vector<float> data;
-    std::vector<unsigned int> indices;
-
-    for (int y = 0; y <= rings; ++y)
-    {
-        float v = (float)y / rings;
-        float phi = v * std::numbers::pi_v<float>;
+    const SinCosTable around(segments, 2.0 * std::numbers::pi);
+    const SinCosTable polar(rings, std::numbers::pi);
 
-        for (int x = 0; x <= segments; ++x)
-        {
-            float u = (float)x / segments;
-            float theta = u * std::numbers::pi_v<float> *2.0f;
-
-            glm::vec3 pos{
-                radius * sin(phi) * cos(theta),
-                radius * cos(phi),
-                radius * sin(phi) * sin(theta)
-            };
-            glm::vec3 n = glm::normalize(pos);
-            pushVertex(data, pos, n, { u, v });
-        }
-    }
+    std::vector<Vertex> vertices(size_t(rings + 1) * (segments + 1));
+    std::vector<unsigned int> indices(size_t(rings) * segments * 6);
 
-    for (int y = 0; y < rings; ++y)
+    // ring y sits at polar angle phi; its normal is the unit direction from the center
+    for (int y = 0; y <= rings; ++y)
     {
-        for (int x = 0; x < segments; ++x)
-        {
-            unsigned int i0 = y * (segments + 1) + x;
-            unsigned int i1 = i0 + segments + 1;
-            indices.insert(indices.end(), { i0, i1, i0 + 1, i1, i1 + 1, i0 + 1 });
-        }
+        const float sinPhi = polar.sin[y], cosPhi = polar.cos[y];
+        writeRing(&vertices[size_t(y) * (segments + 1)], around, segments,
+            radius * sinPhi, radius * cosPhi, sinPhi, cosPhi, (float)y / rings);
     }
+    writeGrid(indices.data(), 0, segments, rings);
 
-    return Mesh::CreateFromIndexedData(
-        data.data(), data.size() * sizeof(float),
-        indices.data(), indices.size() * sizeof(unsigned int),
-        indices.size()
-    );
+    return Mesh(std::move(vertices), std::move(indices), options);
 }
 
 // ------------------------------------------------------------
 // CYLINDER
 // ------------------------------------------------------------
-Mesh GeometryFactory::CreateCylinder(float radius, float height, int segments)
+static Mesh buildCylinder(float radius, float height, int segments, const MeshOptions& options = FACTORY_OPTIONS)
 {
-    std::vector<float> data;
-    std::vector<unsigned int> indices;
-    float halfH = height * 0.5f;
+    const SinCosTable around(segments, 2.0 * std::numbers::pi);
+    const float halfH = height * 0.5f;
+    const size_t ring = segments + 1;
 
-    // --- Side vertices ---
-    for (int i = 0; i <= segments; ++i)
-    {
-        float theta = (i / (float)segments) * 2.0f * std::numbers::pi_v<float>;
-        float x = cos(theta), z = sin(theta);
-        glm::vec3 normal{ x, 0, z };
+    // side: bottom ring, top ring; then bottom cap, top cap (center + rim each)
+    std::vector<Vertex> vertices(4 * ring + 2);
+    std::vector<unsigned int> indices(size_t(segments) * 12);
 
-        pushVertex(data, { radius * x, -halfH, radius * z }, normal, { (float)i / segments, 0 });
-        pushVertex(data, { radius * x,  halfH, radius * z }, normal, { (float)i / segments, 1 });
-    }
+    writeRing(&vertices[0], around, segments, radius, -halfH, 1.0f, 0.0f, 0.0f);
+    writeRing(&vertices[ring], around, segments, radius, halfH, 1.0f, 0.0f, 1.0f);
 
-    // --- Side indices ---
-    for (int i = 0; i < segments; ++i)
-    {
-        unsigned int base = i * 2;
-        indices.insert(indices.end(), { base, base + 1, base + 2, base + 1, base + 3, base + 2 });
-    }
+    const unsigned int bottomCenterIndex = static_cast<unsigned int>(2 * ring);
+    const unsigned int topCenterIndex = static_cast<unsigned int>(3 * ring + 1);
+    writeCap(&vertices[bottomCenterIndex], around, segments, radius, -halfH, -1.0f);
+    writeCap(&vertices[topCenterIndex], around, segments, radius, halfH, 1.0f);
 
-    // --- Bottom cap ---
-    unsigned int bottomCenterIndex = data.size() / 8;
-    pushVertex(data, { 0, -halfH, 0 }, { 0, -1, 0 }, { 0.5f, 0.5f });
+    unsigned int* out = writeGrid(indices.data(), 0, segments, 1);
+    out = writeFan(out, bottomCenterIndex, segments, false);
+    writeFan(out, topCenterIndex, segments, true);
 
-    for (int i = 0; i <= segments; ++i)
-    {
-        float theta = (i / (float)segments) * 2.0f * std::numbers::pi_v<float>;
-        float x = cos(theta), z = sin(theta);
-        pushVertex(data, { radius * x, -halfH, radius * z }, { 0, -1, 0 }, { (x + 1) * 0.5f, (z + 1) * 0.5f });
-    }
+    return Mesh(std::move(vertices), std::move(indices), options);
+}
 
-    for (int i = 0; i < segments; ++i)
-    {
-        indices.insert(indices.end(), {
-            bottomCenterIndex,
-            bottomCenterIndex + i + 1,
-            bottomCenterIndex + i + 2
-            });
-    }
+// ------------------------------------------------------------
+// CONE
+// ------------------------------------------------------------
+static Mesh buildCone(float radius, float height, int segments, const MeshOptions& options = FACTORY_OPTIONS)
+{
+    const SinCosTable around(segments, 2.0 * std::numbers::pi);
+    const float halfH = height * 0.5f;
+    const unsigned int ring = segments + 1;
 
-    // --- Top cap ---
-    unsigned int topCenterIndex = data.size() / 8;
-    pushVertex(data, { 0, halfH, 0 }, { 0, 1, 0 }, { 0.5f, 0.5f });
+    // base ring (side normals), apex, base cap (center + rim with a separate normal)
+    std::vector<Vertex> vertices(2 * ring + 2);
+    std::vector<unsigned int> indices(size_t(segments) * 6);
 
-    for (int i = 0; i <= segments; ++i)
-    {
-        float theta = (i / (float)segments) * 2.0f * std::numbers::pi_v<float>;
-        float x = cos(theta), z = sin(theta);
-        pushVertex(data, { radius * x, halfH, radius * z }, { 0, 1, 0 }, { (x + 1) * 0.5f, (z + 1) * 0.5f });
-    }
+    // side normal: (x, radius / height, z), normalized
+    const float slope = radius / height;
+    const float invLength = 1.0f / std::sqrt(1.0f + slope * slope);
+    writeRing(&vertices[0], around, segments, radius, -halfH, invLength, slope * invLength, 0.0f);
+
+    const unsigned int apexIndex = ring;
+    vertices[apexIndex] = { { 0, halfH, 0 }, { 0, 1, 0 }, { 0.5f, 1 } };
+
+    const unsigned int baseCenterIndex = ring + 1;
+    writeCap(&vertices[baseCenterIndex], around, segments, radius, -halfH, -1.0f);
 
+    unsigned int* out = indices.data();
     for (int i = 0; i < segments; ++i)
     {
-        indices.insert(indices.end(), {
-            topCenterIndex,
-            topCenterIndex + i + 2,
-            topCenterIndex + i + 1
-            });
+        out[0] = i; out[1] = i + 1; out[2] = apexIndex;
+        out += 3;
     }
+    writeFan(out, baseCenterIndex, segments, true);
 
-    return Mesh::CreateFromIndexedData(
-        data.data(), data.size() * sizeof(float),
-        indices.data(), indices.size() * sizeof(unsigned int),
-        indices.size()
-    );
+    return Mesh(std::move(vertices), std::move(indices), options);
 }
 
 // ------------------------------------------------------------
-// CONE
+// TORUS
 // ------------------------------------------------------------
-Mesh GeometryFactory::CreateCone(float radius, float height, int segments)
+static Mesh buildTorus(float radius, float tubeRadius, int segments, int rings, const MeshOptions& options = FACTORY_OPTIONS)
 {
-    std::vector<float> data;
-    std::vector<unsigned int> indices;
-    float halfH = height * 0.5f;
+    const SinCosTable around(segments, 2.0 * std::numbers::pi);
+    const SinCosTable tube(rings, 2.0 * std::numbers::pi);
 
-    glm::vec3 apex{ 0, halfH, 0 };
+    std::vector<Vertex> vertices(size_t(rings + 1) * (segments + 1));
+    std::vector<unsigned int> indices(size_t(rings) * segments * 6);
 
-    // --- Base ring ---
-    for (int i = 0; i <= segments; ++i)
+    // ring = one circle around the main axis at tube angle v
+    for (int ring = 0; ring <= rings; ++ring)
     {
-        float theta = (i / (float)segments) * 2.0f * std::numbers::pi_v<float>;
-        float x = cos(theta), z = sin(theta);
-        glm::vec3 pos{ radius * x, -halfH, radius * z };
-        glm::vec3 normal = glm::normalize(glm::vec3(x, radius / height, z));
-        pushVertex(data, pos, normal, { (float)i / segments, 0 });
+        const float cosV = tube.cos[ring], sinV = tube.sin[ring];
+        writeRing(&vertices[size_t(ring) * (segments + 1)], around, segments,
+            radius + tubeRadius * cosV, tubeRadius * sinV, cosV, sinV, (float)ring / rings);
     }
+    writeGrid(indices.data(), 0, segments, rings);
 
-    // --- Apex vertex ---
-    pushVertex(data, apex, { 0,1,0 }, { 0.5f,1 });
-    unsigned int apexIndex = data.size() / 8 - 1;
-
-    // --- Side triangles ---
-    for (int i = 0; i < segments; ++i)
-    {
-        indices.insert(indices.end(), { (unsigned)i, (unsigned)(i + 1), apexIndex });
-    }
+    return Mesh(std::move(vertices), std::move(indices), options);
+}
 
-    // --- Base center ---
-    unsigned int baseCenterIndex = data.size() / 8;
-    pushVertex(data, { 0, -halfH, 0 }, { 0, -1, 0 }, { 0.5f, 0.5f });
+// ------------------------------------------------------------
+// LOD - procedural shapes are simply rebuilt with fewer segments: exact, and
+// much cheaper than running the edge-collapse simplifier on the full mesh
+// ------------------------------------------------------------
 
-    // --- Base ring again (for separate normal) ---
-    unsigned int baseStart = data.size() / 8;
-    for (int i = 0; i <= segments; ++i)
-    {
-        float theta = (i / (float)segments) * 2.0f * std::numbers::pi_v<float>;
-        float x = cos(theta), z = sin(theta);
-        pushVertex(data, { radius * x, -halfH, radius * z }, { 0, -1, 0 }, { (x + 1) * 0.5f, (z + 1) * 0.5f });
-    }
+// Largest distance between a circle and a polygon with `sides` per full turn
+static float chordError(float radius, int sides)
+{
+    return radius * (1.0f - std::cos(std::numbers::pi_v<float> / sides));
+}
 
-    // --- Base triangles ---
-    for (int i = 0; i < segments; ++i)
+// buildLevel(level, lod) fills in level `level` (1 = first coarser one) with its
+// lodError set, or returns false once the shape would get too coarse
+template <typename BuildLevel>
+static Mesh withLods(Mesh mesh, BuildLevel buildLevel)
+{
+    for (int level = 1; level <= FACTORY_LOD_LEVELS; ++level)
     {
-        indices.insert(indices.end(), {
-            baseCenterIndex,
-            baseStart + i + 1,
-            baseStart + i
-            });
+        Mesh lod;
+        if (!buildLevel(level, lod)) break;
+        mesh.lods.push_back(std::move(lod));
     }
-
-    return Mesh::CreateFromIndexedData(
-        data.data(), data.size() * sizeof(float),
-        indices.data(), indices.size() * sizeof(unsigned int),
-        indices.size()
-    );
+    return mesh;
 }
 
 // ------------------------------------------------------------
-// TORUS
+// CACHE - primitives interned by (shape, parameters)
 // ------------------------------------------------------------
-Mesh GeometryFactory::CreateTorus(float radius, float tubeRadius, int segments, int rings)
+namespace
 {
-    std::vector<float> data;
-    std::vector<unsigned int> indices;
+    enum class Primitive : uint8_t { Cube, Plane, Sphere, Cylinder, Cone, Torus };
 
-    for (int ring = 0; ring <= rings; ++ring)
+    struct ShapeKey
     {
-        float v = (float)ring / rings * 2.0f * std::numbers::pi_v<float>;
-        float cosV = cos(v), sinV = sin(v);
+        Primitive primitive;
+        float a = 0.0f;
+        float b = 0.0f;
+        int c = 0;
+        int d = 0;
 
-        for (int seg = 0; seg <= segments; ++seg)
-        {
-            float u = (float)seg / segments * 2.0f * std::numbers::pi_v<float>;
-            float cosU = cos(u), sinU = sin(u);
-
-            glm::vec3 pos{
-                (radius + tubeRadius * cosV) * cosU,
-                tubeRadius * sinV,
-                (radius + tubeRadius * cosV) * sinU
-            };
-            glm::vec3 n{
-                cosU * cosV,
-                sinV,
-                sinU * cosV
-            };
-            pushVertex(data, pos, glm::normalize(n), { (float)seg / segments, (float)ring / rings });
-        }
-    }
+        auto operator<=>(const ShapeKey&) const = default;
+    };
+
+    std::map<ShapeKey, std::weak_ptr<Mesh>> cache;
 
-    for (int ring = 0; ring < rings; ++ring)
+    template <typename Build>
+    std::shared_ptr<Mesh> intern(const ShapeKey& key, Build build)
     {
-        for (int seg = 0; seg < segments; ++seg)
+        auto it = cache.find(key);
+        if (it != cache.end())
         {
-            unsigned int i0 = ring * (segments + 1) + seg;
-            unsigned int i1 = i0 + segments + 1;
-            indices.insert(indices.end(), { i0, i1, i0 + 1, i1, i1 + 1, i0 + 1 });
+            if (std::shared_ptr<Mesh> mesh = it->second.lock())
+                return mesh;
         }
+
+        // drop entries whose meshes were released before adding a new one
+        std::erase_if(cache, [](const auto& entry) { return entry.second.expired(); });
+
+        auto mesh = std::make_shared<Mesh>(build());
+        cache[key] = mesh;
+        return mesh;
     }
+}
+
+std::shared_ptr<Mesh> GeometryFactory::CreateCube(float size)
+{
+    return intern({ Primitive::Cube, size }, [&] { return buildCube(size); });
+}
+
+std::shared_ptr<Mesh> GeometryFactory::CreatePlane(float size)
+{
+    return intern({ Primitive::Plane, size }, [&] { return buildPlane(size); });
+}
+
+std::shared_ptr<Mesh> GeometryFactory::CreateSphere(float radius, int segments, int rings)
+{
+    return intern({ Primitive::Sphere, radius, 0.0f, segments, rings },
+        [&] {
+            return withLods(buildSphere(radius, segments, rings), [&](int level, Mesh& lod) {
+                const int s = segments >> level, r = rings >> level;
+                if (s < 3 || r < 2 || 2 * s * r < MIN_LOD_TRIANGLES) return false;
+                lod = buildSphere(radius, s, r, FACTORY_LOD_OPTIONS);
+                lod.lodError = std::max(chordError(radius, s), chordError(radius, 2 * r));
+                return true;
+            });
+        });
+}
 
-    return Mesh::CreateFromIndexedData(
-        data.data(), data.size() * sizeof(float),
-        indices.data(), indices.size() * sizeof(unsigned int),
-        indices.size()
-    );
-}
\ No newline at end of file
+std::shared_ptr<Mesh> GeometryFactory::CreateCylinder(float radius, float height, int segments)
+{
+    return intern({ Primitive::Cylinder, radius, height, segments },
+        [&] {
+            return withLods(buildCylinder(radius, height, segments), [&](int level, Mesh& lod) {
+                const int s = segments >> level;
+                if (s < 3 || 4 * s < MIN_LOD_TRIANGLES) return false;
+                lod = buildCylinder(radius, height, s, FACTORY_LOD_OPTIONS);
+                lod.lodError = chordError(radius, s);
+                return true;
+            });
+        });
+}
+
+std::shared_ptr<Mesh> GeometryFactory::CreateCone(float radius, float height, int segments)
+{
+    return intern({ Primitive::Cone, radius, height, segments },
+        [&] {
+            return withLods(buildCone(radius, height, segments), [&](int level, Mesh& lod) {
+                const int s = segments >> level;
+                if (s < 3 || 2 * s < MIN_LOD_TRIANGLES) return false;
+                lod = buildCone(radius, height, s, FACTORY_LOD_OPTIONS);
+                lod.lodError = chordError(radius, s);
+                return true;
+            });
+        });
+}
+
+std::shared_ptr<Mesh> GeometryFactory::CreateTorus(float radius, float tubeRadius, int segments, int rings)
+{
+    return intern({ Primitive::Torus, radius, tubeRadius, segments, rings },
+        [&] {
+            return withLods(buildTorus(radius, tubeRadius, segments, rings), [&](int level, Mesh& lod) {
+                const int s = segments >> level, r = rings >> level;
+                if (s < 3 || r < 3 || 2 * s * r < MIN_LOD_TRIANGLES) return false;
+                lod = buildTorus(radius, tubeRadius, s, r, FACTORY_LOD_OPTIONS);
+                lod.lodError = chordError(radius + tubeRadius, s) + chordError(tubeRadius, r);
+                return true;
+            });
+        });
+}
+
+size_t GeometryFactory::CachedCount()
+{
+    size_t alive = 0;
+    for (const auto& entry : cache)
+        alive += entry.second.expired() ? 0 : 1;
+    return alive;
+}
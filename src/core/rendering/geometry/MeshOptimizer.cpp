@@ -0,0 +1,292 @@
+#include "core/rendering/geometry/MeshOptimizer.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+    // FIFO post-transform cache; a vertex is resident if it entered within the last cacheSize misses
+    struct CacheSim
+    {
+        std::vector<uint32_t> stamp;
+        uint32_t time;
+        int size;
+
+        CacheSim(size_t vertexCount, int cacheSize)
+            : stamp(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+        void Reset() { time += size + 1; }
+
+        // returns 1 on a miss
+        int Touch(uint32_t v)
+        {
+            if (time - stamp[v] <= static_cast<uint32_t>(size)) return 0;
+            stamp[v] = time++;
+            return 1;
+        }
+    };
+
+    bool validTriangleList(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+    {
+        if (indexCount == 0 || indexCount % 3 != 0) return false;
+        for (size_t i = 0; i < indexCount; ++i)
+            if (indices[i] >= vertexCount) return false;
+        return true;
+    }
+}
+
+float MeshOptimizer::ComputeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize)
+{
+    if (indexCount < 3) return 0.0f;
+
+    CacheSim cache(vertexCount, cacheSize);
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+        misses += cache.Touch(indices[i]);
+    return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+}
+
+// --------------------------------------------
+// Tipsify - fans around a vertex, then moves to the most recently cached
+// neighbour that will still be in cache after its own fan; falls back to
+// the dead-end stack, then to the next unfinished vertex in input order
+// --------------------------------------------
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexCache(uint32_t* indices, size_t indexCount,
+    size_t vertexCount, int cacheSize)
+{
+    std::vector<uint32_t> clusters;
+    const size_t triCount = indexCount / 3;
+    if (triCount == 0) return clusters;
+
+    // vertex -> triangles adjacency (CSR)
+    std::vector<uint32_t> live(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; ++i) live[indices[i]]++;
+
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] = offsets[v] + live[v];
+
+    std::vector<uint32_t> adjacency(indexCount);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indexCount);
+
+    uint32_t time = cacheSize + 1;
+    size_t cursor = 0;
+    int64_t fan = indices[0];
+    clusters.push_back(0);
+
+    while (fan >= 0)
+    {
+        candidates.clear();
+        for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a)
+        {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) continue;
+            emitted[t] = true;
+
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > static_cast<uint32_t>(cacheSize))
+                    cacheTime[v] = time++;
+            }
+        }
+
+        // best candidate: still has triangles and stays cached through its fan
+        int64_t next = -1;
+        int bestPriority = -1;
+        for (uint32_t v : candidates)
+        {
+            if (live[v] == 0) continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= static_cast<uint32_t>(cacheSize))
+                priority = static_cast<int>(time - cacheTime[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        if (next < 0)
+        {
+            // cache locality is lost here: start a new cluster
+            while (!deadEnd.empty() && next < 0)
+            {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) next = v;
+            }
+            while (next < 0 && cursor < vertexCount)
+            {
+                if (live[cursor] > 0) next = static_cast<int64_t>(cursor);
+                ++cursor;
+            }
+            if (next >= 0 && output.size() < indexCount)
+                clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+        }
+        fan = next;
+    }
+
+    std::memcpy(indices, output.data(), indexCount * sizeof(uint32_t));
+    return clusters;
+}
+
+// --------------------------------------------
+// OptimizeOverdraw - splits clusters where the cache cost allows, then draws
+// clusters facing away from the mesh center first (they tend to occlude the rest)
+// --------------------------------------------
+void MeshOptimizer::OptimizeOverdraw(uint32_t* indices, size_t indexCount,
+    const float* positions, size_t positionStride, size_t vertexCount,
+    const std::vector<uint32_t>& clusters, float threshold, int cacheSize)
+{
+    const size_t triCount = indexCount / 3;
+    if (triCount == 0 || clusters.empty()) return;
+
+    // soft boundaries: cut a cluster as soon as the part so far is nearly as cache-efficient as the whole
+    std::vector<uint32_t> bounds;
+    CacheSim cache(vertexCount, cacheSize);
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        const uint32_t begin = clusters[c];
+        const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(triCount);
+
+        cache.Reset();
+        size_t misses = 0;
+        for (uint32_t t = begin; t < end; ++t)
+            for (int k = 0; k < 3; ++k) misses += cache.Touch(indices[t * 3 + k]);
+        const float clusterAcmr = static_cast<float>(misses) / (end - begin);
+
+        bounds.push_back(begin);
+        cache.Reset();
+        misses = 0;
+        uint32_t start = begin;
+        for (uint32_t t = begin; t < end; ++t)
+        {
+            for (int k = 0; k < 3; ++k) misses += cache.Touch(indices[t * 3 + k]);
+            if (t + 1 < end && static_cast<float>(misses) / (t + 1 - start) <= clusterAcmr * threshold)
+            {
+                bounds.push_back(t + 1);
+                cache.Reset();
+                misses = 0;
+                start = t + 1;
+            }
+        }
+    }
+    bounds.push_back(static_cast<uint32_t>(triCount));
+
+    auto position = [&](uint32_t v) {
+        const float* p = positions + v * positionStride;
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // area-weighted centroid and normal per cluster
+    const size_t clusterCount = bounds.size() - 1;
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    std::vector<float> areas(clusterCount, 0.0f);
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        for (uint32_t t = bounds[c]; t < bounds[c + 1]; ++t)
+        {
+            glm::vec3 a = position(indices[t * 3]);
+            glm::vec3 b = position(indices[t * 3 + 1]);
+            glm::vec3 d = position(indices[t * 3 + 2]);
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float area = glm::length(n);
+
+            centroids[c] += (a + b + d) * (area / 3.0f);
+            normals[c] += n;
+            areas[c] += area;
+        }
+        meshCenter += centroids[c];
+        meshArea += areas[c];
+        if (areas[c] > 0.0f) centroids[c] /= areas[c];
+    }
+    if (meshArea > 0.0f) meshCenter /= meshArea;
+
+    std::vector<float> sortKey(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        float len = glm::length(normals[c]);
+        sortKey[c] = len > 0.0f ? glm::dot(centroids[c] - meshCenter, normals[c] / len) : 0.0f;
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+        [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indexCount);
+    for (uint32_t c : order)
+        output.insert(output.end(), indices + bounds[c] * 3, indices + bounds[c + 1] * 3);
+    std::memcpy(indices, output.data(), indexCount * sizeof(uint32_t));
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize,
+    uint32_t* indices, size_t indexCount)
+{
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    std::vector<unsigned char> output(vertexCount * vertexSize);
+    const unsigned char* src = static_cast<const unsigned char*>(vertices);
+
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t& slot = remap[indices[i]];
+        if (slot == UINT32_MAX)
+        {
+            std::memcpy(&output[next * vertexSize], src + indices[i] * vertexSize, vertexSize);
+            slot = next++;
+        }
+        indices[i] = slot;
+    }
+
+    std::memcpy(vertices, output.data(), next * vertexSize);
+    return next;
+}
+
+MeshOptimizer::Report MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    static_assert(sizeof(unsigned int) == sizeof(uint32_t), "indices are processed as uint32_t");
+
+    Report report;
+    report.triangles = indices.size() / 3;
+    if (!validTriangleList(indices.data(), indices.size(), vertices.size()))
+        return report;
+
+    report.acmrBefore = ComputeACMR(indices.data(), indices.size(), vertices.size());
+
+    // small procedural meshes are often emitted in a near-ideal strip order already;
+    // keep whichever order is cheaper
+    std::vector<unsigned int> original = indices;
+    std::vector<uint32_t> clusters = OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+    OptimizeOverdraw(indices.data(), indices.size(), &vertices[0].Position.x, sizeof(Vertex) / sizeof(float),
+        vertices.size(), clusters);
+    if (ComputeACMR(indices.data(), indices.size(), vertices.size()) > report.acmrBefore)
+        indices.swap(original);
+
+    size_t used = OptimizeVertexFetch(vertices.data(), vertices.size(), sizeof(Vertex),
+        indices.data(), indices.size());
+    vertices.resize(used);
+
+    report.acmrAfter = ComputeACMR(indices.data(), indices.size(), vertices.size());
+    report.optimized = true;
+    return report;
+}
@@ -0,0 +1,264 @@
+#include "core/rendering/geometry/MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    // Symmetric 4x4 plane quadric plus the area it was accumulated from
+    struct Quadric
+    {
+        double xx = 0, xy = 0, xz = 0, xw = 0;
+        double yy = 0, yz = 0, yw = 0;
+        double zz = 0, zw = 0;
+        double ww = 0;
+        double weight = 0;
+
+        void AddPlane(const glm::dvec3& n, double d, double w)
+        {
+            xx += w * n.x * n.x; xy += w * n.x * n.y; xz += w * n.x * n.z; xw += w * n.x * d;
+            yy += w * n.y * n.y; yz += w * n.y * n.z; yw += w * n.y * d;
+            zz += w * n.z * n.z; zw += w * n.z * d;
+            ww += w * d * d;
+            weight += w;
+        }
+
+        void Add(const Quadric& q)
+        {
+            xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw;
+            yy += q.yy; yz += q.yz; yw += q.yw;
+            zz += q.zz; zw += q.zw;
+            ww += q.ww;
+            weight += q.weight;
+        }
+
+        // mean squared distance of p to the accumulated planes
+        double Error(const glm::vec3& p) const
+        {
+            const double x = p.x, y = p.y, z = p.z;
+            double e = xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x
+                + yy * y * y + 2 * yz * y * z + 2 * yw * y
+                + zz * z * z + 2 * zw * z
+                + ww;
+            return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t from;  // vertex removed
+        uint32_t to;    // vertex it merges into
+        double cost;
+    };
+
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3& p) const
+        {
+            uint32_t h[3];
+            std::memcpy(h, &p, sizeof(h));
+            return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+        }
+    };
+
+    uint64_t edgeKey(uint32_t a, uint32_t b)
+    {
+        if (a > b) std::swap(a, b);
+        return (static_cast<uint64_t>(a) << 32) | b;
+    }
+
+    // Triangles of the current index list around each position (CSR)
+    struct Adjacency
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+
+        void Build(const std::vector<unsigned int>& indices, const std::vector<uint32_t>& position, size_t count)
+        {
+            offsets.assign(count + 1, 0);
+            for (unsigned int i : indices) offsets[position[i] + 1]++;
+            for (size_t p = 0; p < count; ++p) offsets[p + 1] += offsets[p];
+
+            triangles.resize(indices.size());
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); ++i)
+                triangles[fill[position[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+        }
+    };
+}
+
+float MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float maxError, std::vector<unsigned int>& result)
+{
+    result = indices;
+    if (indices.size() % 3 != 0 || indices.size() <= targetIndexCount) return 0.0f;
+
+    // --- topology on unique positions (UV/normal seams split vertices, not surfaces) ---
+    std::vector<uint32_t> position(vertices.size());
+    std::vector<uint32_t> wedges;
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> unique;
+        for (size_t v = 0; v < vertices.size(); ++v)
+        {
+            auto it = unique.emplace(vertices[v].Position, static_cast<uint32_t>(unique.size())).first;
+            position[v] = it->second;
+            if (it->second == wedges.size()) wedges.push_back(0);
+            wedges[it->second]++;
+        }
+    }
+    const size_t positionCount = wedges.size();
+
+    // locked: seams, open borders and non-manifold edges
+    std::vector<bool> locked(positionCount, false);
+    {
+        std::unordered_map<uint64_t, uint32_t> edgeUse;
+        for (size_t t = 0; t < indices.size(); t += 3)
+            for (int k = 0; k < 3; ++k)
+                edgeUse[edgeKey(position[indices[t + k]], position[indices[t + (k + 1) % 3]])]++;
+
+        for (const auto& [key, count] : edgeUse)
+        {
+            if (count == 2) continue;
+            locked[key >> 32] = true;
+            locked[key & 0xFFFFFFFF] = true;
+        }
+        for (size_t p = 0; p < positionCount; ++p)
+            if (wedges[p] > 1) locked[p] = true;
+    }
+
+    // --- area-weighted plane quadrics per position ---
+    std::vector<Quadric> quadrics(positionCount);
+    for (size_t t = 0; t < indices.size(); t += 3)
+    {
+        glm::dvec3 a = vertices[indices[t]].Position;
+        glm::dvec3 b = vertices[indices[t + 1]].Position;
+        glm::dvec3 c = vertices[indices[t + 2]].Position;
+        glm::dvec3 n = glm::cross(b - a, c - a);
+        double area = glm::length(n);
+        if (area <= 0.0) continue;
+        n /= area;
+        for (int k = 0; k < 3; ++k)
+            quadrics[position[indices[t + k]]].AddPlane(n, -glm::dot(n, a), area * 0.5);
+    }
+
+    const double maxCost = static_cast<double>(maxError) * maxError;
+    double reached = 0.0;
+
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<Collapse> collapses;
+    std::vector<bool> touched;
+    std::vector<uint32_t> ringU, ringV;
+    Adjacency adjacency;
+
+    auto ring = [&](uint32_t p, std::vector<uint32_t>& out) {
+        out.clear();
+        for (uint32_t a = adjacency.offsets[p]; a < adjacency.offsets[p + 1]; ++a)
+        {
+            const uint32_t t = adjacency.triangles[a] * 3;
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t q = position[result[t + k]];
+                if (q != p && std::find(out.begin(), out.end(), q) == out.end()) out.push_back(q);
+            }
+        }
+    };
+
+    // one pass collapses an independent set of edges, cheapest first
+    while (result.size() > targetIndexCount)
+    {
+        collapses.clear();
+        for (size_t t = 0; t < result.size(); t += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                const uint32_t a = result[t + k];
+                const uint32_t b = result[t + (k + 1) % 3];
+                const uint32_t pa = position[a], pb = position[b];
+                // every interior edge is seen twice, in opposite directions; keep one
+                if (pa >= pb) continue;
+
+                Quadric q = quadrics[pa];
+                q.Add(quadrics[pb]);
+                if (!locked[pa]) collapses.push_back({ a, b, q.Error(vertices[b].Position) });
+                if (!locked[pb]) collapses.push_back({ b, a, q.Error(vertices[a].Position) });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+            [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        adjacency.Build(result, position, positionCount);
+        touched.assign(positionCount, false);
+        for (size_t v = 0; v < remap.size(); ++v) remap[v] = static_cast<uint32_t>(v);
+
+        size_t triangles = result.size() / 3;
+        const size_t targetTriangles = targetIndexCount / 3;
+        size_t applied = 0;
+
+        for (const Collapse& c : collapses)
+        {
+            if (c.cost > maxCost || triangles <= targetTriangles) break;
+
+            const uint32_t pu = position[c.from], pv = position[c.to];
+            if (touched[pu] || touched[pv]) continue;
+
+            // link condition: the two rings may only share the edge's two opposite vertices
+            ring(pu, ringU);
+            ring(pv, ringV);
+            int shared = 0;
+            for (uint32_t q : ringU)
+                shared += std::find(ringV.begin(), ringV.end(), q) != ringV.end() ? 1 : 0;
+            if (shared > 2) continue;
+
+            // no triangle around u may flip when u moves onto v
+            const glm::vec3 target = vertices[c.to].Position;
+            bool flips = false;
+            for (uint32_t a = adjacency.offsets[pu]; a < adjacency.offsets[pu + 1] && !flips; ++a)
+            {
+                const uint32_t t = adjacency.triangles[a] * 3;
+                glm::vec3 p[3], moved[3];
+                bool hasV = false;
+                for (int k = 0; k < 3; ++k)
+                {
+                    p[k] = vertices[result[t + k]].Position;
+                    moved[k] = position[result[t + k]] == pu ? target : p[k];
+                    hasV |= position[result[t + k]] == pv;
+                }
+                if (hasV) continue;     // collapses away
+
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                // also refuse to turn a face by more than ~75 degrees
+                flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+            }
+            if (flips) continue;
+
+            remap[c.from] = c.to;
+            quadrics[pv].Add(quadrics[pu]);
+            reached = std::max(reached, c.cost);
+
+            // keep this pass's collapses independent: their neighbourhoods must not overlap
+            touched[pu] = touched[pv] = true;
+            for (uint32_t q : ringU) touched[q] = true;
+
+            triangles -= 2;
+            ++applied;
+        }
+        if (applied == 0) break;
+
+        // apply the collapses and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t t = 0; t < result.size(); t += 3)
+        {
+            const uint32_t a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+            const uint32_t pa = position[a], pb = position[b], pc = position[c];
+            if (pa == pb || pb == pc || pa == pc) continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    return static_cast<float>(std::sqrt(reached));
+}
@@ -0,0 +1,169 @@
+#include "core/rendering/geometry/MeshletBuilder.h"
+#include <algorithm>
+
+namespace
+{
+    // Below this the normals spread past ~84 degrees from the axis: no cone
+    constexpr float MIN_CONE_DOT = 0.1f;
+
+    void computeBounds(const std::vector<Vertex>& vertices, const unsigned int* indices, Meshlet& m)
+    {
+        glm::vec3 lo = vertices[indices[0]].Position;
+        glm::vec3 hi = lo;
+        for (uint32_t i = 1; i < m.indexCount; ++i)
+        {
+            lo = glm::min(lo, vertices[indices[i]].Position);
+            hi = glm::max(hi, vertices[indices[i]].Position);
+        }
+        m.center = (lo + hi) * 0.5f;
+        float r2 = 0.0f;
+        for (uint32_t i = 0; i < m.indexCount; ++i)
+        {
+            glm::vec3 d = vertices[indices[i]].Position - m.center;
+            r2 = std::max(r2, glm::dot(d, d));
+        }
+        m.radius = glm::sqrt(r2);
+
+        // face normals, oriented to agree with the authored vertex normals
+        // (so clockwise-wound meshes still get outward-facing cones)
+        std::vector<glm::vec3> normals;
+        normals.reserve(m.indexCount / 3);
+        glm::vec3 axis(0.0f);
+        for (uint32_t t = 0; t < m.indexCount; t += 3)
+        {
+            const Vertex& a = vertices[indices[t]];
+            const Vertex& b = vertices[indices[t + 1]];
+            const Vertex& c = vertices[indices[t + 2]];
+            const glm::vec3 e1 = b.Position - a.Position;
+            const glm::vec3 e2 = c.Position - a.Position;
+            glm::vec3 n = glm::cross(e1, e2);
+            // slivers (e.g. at the poles of a UV sphere) have numerically random normals
+            float len2 = glm::dot(n, n);
+            const float longest = std::max(glm::dot(e1, e1), glm::dot(e2, e2));
+            if (len2 <= 1e-8f * longest * longest) continue;
+            n /= glm::sqrt(len2);
+            if (glm::dot(n, a.Normal + b.Normal + c.Normal) < 0.0f) n = -n;
+            normals.push_back(n);
+            axis += n;
+        }
+
+        float axisLength = glm::length(axis);
+        if (normals.empty() || axisLength <= 0.0f) return;
+        axis /= axisLength;
+
+        float minDot = 1.0f;
+        for (const glm::vec3& n : normals)
+            minDot = std::min(minDot, glm::dot(axis, n));
+        if (minDot < MIN_CONE_DOT) return;
+
+        m.coneAxis = axis;
+        m.coneCutoff = glm::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+std::vector<Meshlet> MeshletBuilder::Build(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    std::vector<Meshlet> meshlets;
+    const size_t triCount = indices.size() / 3;
+    if (triCount == 0 || indices.size() % 3 != 0) return meshlets;
+
+    // vertex -> triangles adjacency (CSR)
+    std::vector<uint32_t> offsets(vertices.size() + 1, 0);
+    for (unsigned int v : indices) offsets[v + 1]++;
+    for (size_t v = 0; v < vertices.size(); ++v) offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<bool> emitted(triCount, false);
+    // owner[v] = meshlet that already holds v (UINT32_MAX = none yet)
+    std::vector<uint32_t> owner(vertices.size(), UINT32_MAX);
+    std::vector<uint32_t> meshletVertices;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    auto newVertices = [&](uint32_t t, uint32_t id) {
+        uint32_t added = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t v = indices[t * 3 + k];
+            bool repeated = (k > 0 && indices[t * 3] == v) || (k > 1 && indices[t * 3 + 1] == v);
+            added += owner[v] != id && !repeated ? 1 : 0;
+        }
+        return added;
+    };
+
+    auto triangleCenter = [&](uint32_t t) {
+        return (vertices[indices[t * 3]].Position + vertices[indices[t * 3 + 1]].Position
+            + vertices[indices[t * 3 + 2]].Position) * (1.0f / 3.0f);
+    };
+
+    size_t seed = 0;
+    while (true)
+    {
+        while (seed < triCount && emitted[seed]) ++seed;
+        if (seed == triCount) break;
+
+        const uint32_t id = static_cast<uint32_t>(meshlets.size());
+        Meshlet meshlet;
+        meshlet.firstIndex = static_cast<uint32_t>(output.size());
+        meshletVertices.clear();
+        uint32_t triangles = 0;
+        glm::vec3 centroidSum(0.0f);
+
+        int64_t next = static_cast<int64_t>(seed);
+        while (next >= 0)
+        {
+            const uint32_t t = static_cast<uint32_t>(next);
+            emitted[t] = true;
+            centroidSum += triangleCenter(t);
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                if (owner[v] != id)
+                {
+                    owner[v] = id;
+                    meshletVertices.push_back(v);
+                }
+            }
+            if (++triangles == MAX_TRIANGLES) break;
+
+            // grow through the cluster's vertices: the triangle adding fewest new ones
+            // wins, ties go to the one closest to the cluster (keeps bounds and cones tight)
+            next = -1;
+            uint32_t best = 4;
+            float bestDistance = 0.0f;
+            const glm::vec3 centroid = centroidSum / static_cast<float>(triangles);
+            for (uint32_t v : meshletVertices)
+            {
+                for (uint32_t a = offsets[v]; a < offsets[v + 1]; ++a)
+                {
+                    uint32_t candidate = adjacency[a];
+                    if (emitted[candidate]) continue;
+                    uint32_t added = newVertices(candidate, id);
+                    if (added > best || meshletVertices.size() + added > MAX_VERTICES) continue;
+
+                    glm::vec3 d = triangleCenter(candidate) - centroid;
+                    float distance = glm::dot(d, d);
+                    if (added < best || distance < bestDistance)
+                    {
+                        best = added;
+                        bestDistance = distance;
+                        next = candidate;
+                    }
+                }
+            }
+        }
+
+        meshlet.indexCount = static_cast<uint32_t>(output.size()) - meshlet.firstIndex;
+        computeBounds(vertices, output.data() + meshlet.firstIndex, meshlet);
+        meshlets.push_back(meshlet);
+    }
+
+    indices.swap(output);
+    return meshlets;
+}
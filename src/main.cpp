@@ -12,6 +12,13 @@
 #include "core/Window.h"
 #include "core/InputManager.h"
 #include "core/rendering/Model.h"
+#include "core/rendering/geometry/GeometryFactory.h"
+#include "core/rendering/GLState.h"
+#include "core/rendering/GeometryPool.h"
+#include "core/rendering/TextureUploader.h"
+#include "core/rendering/ProgramCache.h"
+#include "core/JobSystem.h"
+#include "core/ImageDecoder.h"
 #include "scenes/test.h"
 
 int main()
@@ -28,6 +35,11 @@ int main()
     Window win(800, 600, "win");
     win.SetAppState(&appState);
 
+    // worker threads for per-frame culling
+    JobSystem::Init();
+    // and for texture decoding
+    ImageDecoder::Init();
+
     // -------------------------
     // 5. Init scenes
     // -------------------------
@@ -38,6 +50,14 @@ int main()
     for (auto* scene : appState.scenes)
         scene->init();
 
+#ifdef PYRE_VERBOSE
+    // models loading in the background report their share when they finish
+    std::cout << "Mesh: " << Mesh::ReleasedCpuBytes() / 1024
+        << " KB of CPU geometry released after upload during init\n";
+    std::cout << "GeometryFactory: " << GeometryFactory::CachedCount()
+        << " distinct primitive meshes shared by the scenes\n";
+#endif
+
 
     // 3. Bind inputs
     InputManager* input = win.GetInputManager();
@@ -103,21 +123,38 @@ int main()
 
 
         input->Update(appState.deltaTime);
+        // meshes and textures of models loading in the background
+        Model::UploadPending(Model::UPLOAD_BUDGET_MS);
+        // and texture pixels, within the per-frame byte budget
+        TextureUploader::Update();
 
         if (!appState.scenes.empty()) {
             appState.scenes[appState.currentSceneIndex]->update();
             appState.scenes[appState.currentSceneIndex]->render();
         }
+        // streamed geometry written this frame is now referenced by queued draws
+        GeometryPool::EndFrame();
 
-        glStencilMask(0xFF);
-        glStencilFunc(GL_ALWAYS, 0, 0xFF);
-        glEnable(GL_DEPTH_TEST);
+        GLState::StencilMask(0xFF);
+        GLState::StencilFunc(GL_ALWAYS, 0, 0xFF);
+        GLState::SetDepthTest(true);
         win.PollEvents();
         win.SwapBuffers();
     }
 
+#ifdef PYRE_VERBOSE
+    // after the loop, so shader variants specialized while drawing are counted too
+    if (ProgramCache::Enabled())
+        std::cout << "ProgramCache: " << ProgramCache::Restored() << " programs restored, "
+            << ProgramCache::Saved() << " compiled and saved\n";
+#endif
+
     for (auto* s : appState.scenes)
         delete s;
+    GeometryPool::Clear();
+    TextureUploader::Clear();
+    JobSystem::Shutdown();
+    ImageDecoder::Shutdown();
 
     glfwTerminate();
     return 0;